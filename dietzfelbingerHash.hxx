@@ -6,6 +6,9 @@
 
 class vr_dietzfelbinger_hash {
 public:
+  // keyed directly by the seed: nothing to rebuild on reseed
+  static inline void setKey(__attribute__((unused)) const Vr_Rand *r) {}
+
   template <int NB>
   static inline bool hashBool(const Vr_Rand *r,
                               const vr_packArg<double, NB> &pack,
@@ -0,0 +1,695 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Accuracy versus cost benchmark of the rounding modes.        ---*/
+/*---                                                 vr_bench.cxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+// Runs a few workloads under every rounding mode of the static backends and
+// prints, for each one, the runtime overhead against the uninstrumented code
+// next to the observed error. The error is the normwise relative distance to
+// the same computation done natively in long double on the same inputs, the
+// maximum over the samples (seeds) for the random modes.
+//
+// With --abi=value (or both), the ops go through the table returning results
+// by value instead (rows suffixed with /value): the stagnation and scalar
+// sum and dot workloads are dependent chains, where the store and reload of
+// the result of each op is on the critical path.
+//
+// --random-engine selects the generator of the random, average and prandom
+// modes, as the option of the same name of the backend.
+//
+// usage: vr_bench [--scale=s] [--samples=n] [--type=float|double]
+//                 [--abi=pointer|value|both]
+//                 [--random-engine=tinymt64|xoshiro256+|sfc64|wyrand]
+//                 [workload..]
+
+#include "../../interflop_verrou.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+// * interflop stdlib handlers
+
+static int vr_bench_fprintf(File *stream, const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  int res = vfprintf((FILE *)stream, format, ap);
+  va_end(ap);
+  return res;
+}
+
+static pid_t vr_bench_gettid(void) { return syscall(SYS_gettid); }
+
+static int vr_bench_gettimeofday(struct timeval *tv, void *tz) {
+  return gettimeofday(tv, (struct timezone *)tz);
+}
+
+static long vr_bench_strtol(const char *nptr, char **endptr, int *error) {
+  errno = 0;
+  long res = strtol(nptr, endptr, 10);
+  *error = errno;
+  return res;
+}
+
+static double vr_bench_strtod(const char *nptr, char **endptr, int *error) {
+  errno = 0;
+  double res = strtod(nptr, endptr);
+  *error = errno;
+  return res;
+}
+
+static void vr_bench_nanInfHandler(void) {}
+
+static void vr_bench_panic(const char *msg) {
+  fprintf(stderr, "%s", msg);
+  abort();
+}
+
+static void vr_bench_set_handlers(void) {
+  interflop_set_handler("exit", (void *)exit);
+  interflop_set_handler("fprintf", (void *)vr_bench_fprintf);
+  interflop_set_handler("sprintf", (void *)sprintf);
+  interflop_set_handler("gettid", (void *)vr_bench_gettid);
+  interflop_set_handler("gettimeofday", (void *)vr_bench_gettimeofday);
+  interflop_set_handler("infHandler", (void *)vr_bench_nanInfHandler);
+  interflop_set_handler("nanHandler", (void *)vr_bench_nanInfHandler);
+  interflop_set_handler("malloc", (void *)malloc);
+  interflop_set_handler("calloc", (void *)calloc);
+  interflop_set_handler("free", (void *)free);
+  interflop_set_handler("strcasecmp", (void *)strcasecmp);
+  interflop_set_handler("strcmp", (void *)strcmp);
+  interflop_set_handler("strtol", (void *)vr_bench_strtol);
+  interflop_set_handler("strtod", (void *)vr_bench_strtod);
+  interflop_set_handler("getenv", (void *)getenv);
+}
+
+// * Arithmetic policies
+
+// uninstrumented code, also used in long double for the reference
+template <class REAL> class vr_benchNative {
+public:
+  typedef REAL Real;
+  REAL add(REAL a, REAL b) const { return a + b; }
+  REAL sub(REAL a, REAL b) const { return a - b; }
+  REAL mul(REAL a, REAL b) const { return a * b; }
+  REAL div(REAL a, REAL b) const { return a / b; }
+  REAL sum(const REAL *x, size_t n) const {
+    REAL acc = 0;
+    for (size_t i = 0; i < n; i++)
+      acc += x[i];
+    return acc;
+  }
+  REAL dot(const REAL *x, const REAL *y, size_t n) const {
+    REAL acc = 0;
+    for (size_t i = 0; i < n; i++)
+      acc += x[i] * y[i];
+    return acc;
+  }
+};
+
+// each op goes through the backend returned by interflop_verrou_init, as
+// for an instrumented binary
+template <class REAL> class vr_benchVerrou;
+
+template <> class vr_benchVerrou<double> {
+public:
+  typedef double Real;
+  vr_benchVerrou(const struct interflop_backend_interface_t &backend,
+                 void *context)
+      : backend_(backend), context_(context) {}
+  double add(double a, double b) const {
+    double res;
+    backend_.interflop_add_double(a, b, &res, context_);
+    return res;
+  }
+  double sub(double a, double b) const {
+    double res;
+    backend_.interflop_sub_double(a, b, &res, context_);
+    return res;
+  }
+  double mul(double a, double b) const {
+    double res;
+    backend_.interflop_mul_double(a, b, &res, context_);
+    return res;
+  }
+  double div(double a, double b) const {
+    double res;
+    backend_.interflop_div_double(a, b, &res, context_);
+    return res;
+  }
+  double sum(const double *x, size_t n) const {
+    return verrou_sum_double(x, n, context_);
+  }
+  double dot(const double *x, const double *y, size_t n) const {
+    return verrou_dot_double(x, y, n, context_);
+  }
+
+private:
+  struct interflop_backend_interface_t backend_;
+  void *context_;
+};
+
+template <> class vr_benchVerrou<float> {
+public:
+  typedef float Real;
+  vr_benchVerrou(const struct interflop_backend_interface_t &backend,
+                 void *context)
+      : backend_(backend), context_(context) {}
+  float add(float a, float b) const {
+    float res;
+    backend_.interflop_add_float(a, b, &res, context_);
+    return res;
+  }
+  float sub(float a, float b) const {
+    float res;
+    backend_.interflop_sub_float(a, b, &res, context_);
+    return res;
+  }
+  float mul(float a, float b) const {
+    float res;
+    backend_.interflop_mul_float(a, b, &res, context_);
+    return res;
+  }
+  float div(float a, float b) const {
+    float res;
+    backend_.interflop_div_float(a, b, &res, context_);
+    return res;
+  }
+  float sum(const float *x, size_t n) const {
+    return verrou_sum_float(x, n, context_);
+  }
+  float dot(const float *x, const float *y, size_t n) const {
+    return verrou_dot_float(x, y, n, context_);
+  }
+
+private:
+  struct interflop_backend_interface_t backend_;
+  void *context_;
+};
+
+// same through the table returning results by value
+// (interflop_verrou_value_backend)
+template <class REAL> class vr_benchVerrouValue;
+
+template <> class vr_benchVerrouValue<double> {
+public:
+  typedef double Real;
+  vr_benchVerrouValue(const verrou_value_backend_t &backend, void *context)
+      : backend_(backend), context_(context) {}
+  double add(double a, double b) const { return backend_.add_double(a, b); }
+  double sub(double a, double b) const { return backend_.sub_double(a, b); }
+  double mul(double a, double b) const { return backend_.mul_double(a, b); }
+  double div(double a, double b) const { return backend_.div_double(a, b); }
+  double sum(const double *x, size_t n) const {
+    return verrou_sum_double(x, n, context_);
+  }
+  double dot(const double *x, const double *y, size_t n) const {
+    return verrou_dot_double(x, y, n, context_);
+  }
+
+private:
+  verrou_value_backend_t backend_;
+  void *context_;
+};
+
+template <> class vr_benchVerrouValue<float> {
+public:
+  typedef float Real;
+  vr_benchVerrouValue(const verrou_value_backend_t &backend, void *context)
+      : backend_(backend), context_(context) {}
+  float add(float a, float b) const { return backend_.add_float(a, b); }
+  float sub(float a, float b) const { return backend_.sub_float(a, b); }
+  float mul(float a, float b) const { return backend_.mul_float(a, b); }
+  float div(float a, float b) const { return backend_.div_float(a, b); }
+  float sum(const float *x, size_t n) const {
+    return verrou_sum_float(x, n, context_);
+  }
+  float dot(const float *x, const float *y, size_t n) const {
+    return verrou_dot_float(x, y, n, context_);
+  }
+
+private:
+  verrou_value_backend_t backend_;
+  void *context_;
+};
+
+// * Workloads
+
+class vr_benchTimer {
+public:
+  vr_benchTimer() : begin_(std::chrono::steady_clock::now()) {}
+  double elapsed() const {
+    std::chrono::duration<double> dt =
+        std::chrono::steady_clock::now() - begin_;
+    return dt.count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point begin_;
+};
+
+// deterministic inputs, identical for every mode and type
+class vr_benchInput {
+public:
+  explicit vr_benchInput(uint64_t seed) : state_(seed) {}
+  // uniform in [-1,1[ scaled by 2^[-range,range]
+  double next(int range) {
+    state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    double u = (double)(state_ >> 11) * 0x1.0p-52 - 1.;
+    int e = (int)((state_ >> 3) % (2 * range + 1)) - range;
+    return std::ldexp(u, e);
+  }
+
+private:
+  uint64_t state_;
+};
+
+template <class REAL>
+static std::vector<REAL> vr_benchInputVector(size_t n, uint64_t seed,
+                                             int range) {
+  vr_benchInput input(seed);
+  std::vector<REAL> res(n);
+  for (size_t i = 0; i < n; i++)
+    res[i] = (REAL)input.next(range);
+  return res;
+}
+
+// Each workload is instantiated on the working precision REAL and run with
+// an arithmetic policy whose type is either REAL or long double. run()
+// returns the time of the computation only, the result goes to out.
+
+// examples/stagnation: accumulation of a small increment
+template <class REAL> class vr_benchStagnation {
+public:
+  static const char *name() { return "stagnation"; }
+  explicit vr_benchStagnation(double scale)
+      : n_((size_t)(scale * (1 << 24))) {}
+
+  template <class ARITH>
+  double run(const ARITH &a, std::vector<long double> &out) const {
+    typedef typename ARITH::Real R;
+    R acc = (R)(REAL)1e6;
+    const R inc = (R)(REAL)0.1;
+    vr_benchTimer timer;
+    for (size_t i = 0; i < n_; i++)
+      acc = a.add(acc, inc);
+    double dt = timer.elapsed();
+    out.assign(1, acc);
+    return dt;
+  }
+
+private:
+  size_t n_;
+};
+
+// examples/stencil: 3D radius 3 stencil of the wave equation
+template <class REAL> class vr_benchStencil {
+public:
+  static const char *name() { return "stencil"; }
+  explicit vr_benchStencil(double scale)
+      : n_(std::max(16, (int)(48 * std::cbrt(scale)))),
+        a0_(vr_benchInputVector<REAL>((size_t)n_ * n_ * n_, 1, 0)),
+        vsq_(vr_benchInputVector<REAL>((size_t)n_ * n_ * n_, 2, 0)) {}
+
+  template <class ARITH>
+  double run(const ARITH &a, std::vector<long double> &out) const {
+    typedef typename ARITH::Real R;
+    const R coef[4] = {(R)0.5, (R)-.25, (R)0.125, (R)-.0625};
+    std::vector<R> even(a0_.begin(), a0_.end());
+    std::vector<R> odd(even.size(), (R)0);
+    std::vector<R> vsq(vsq_.begin(), vsq_.end());
+    vr_benchTimer timer;
+    for (int t = 0; t < nbStep_; ++t) {
+      if ((t & 1) == 0)
+        step(a, coef, vsq.data(), even.data(), odd.data());
+      else
+        step(a, coef, vsq.data(), odd.data(), even.data());
+    }
+    double dt = timer.elapsed();
+    const std::vector<R> &res = (nbStep_ & 1) ? odd : even;
+    out.assign(res.begin(), res.end());
+    return dt;
+  }
+
+private:
+  template <class ARITH>
+  void step(const ARITH &a, const typename ARITH::Real coef[4],
+            const typename ARITH::Real *vsq, const typename ARITH::Real *in,
+            typename ARITH::Real *next) const {
+    typedef typename ARITH::Real R;
+    const int nx = n_, nxy = n_ * n_;
+    for (int z = width_; z < n_ - width_; ++z) {
+      for (int y = width_; y < n_ - width_; ++y) {
+        for (int x = width_; x < n_ - width_; ++x) {
+          const int index = z * nxy + y * nx + x;
+          R div = a.mul(coef[0], in[index]);
+          for (int r = 1; r <= 3; r++) {
+            R acc = a.add(in[index + r], in[index - r]);
+            acc = a.add(acc, in[index + r * nx]);
+            acc = a.add(acc, in[index - r * nx]);
+            acc = a.add(acc, in[index + r * nxy]);
+            acc = a.add(acc, in[index - r * nxy]);
+            div = a.add(div, a.mul(acc, coef[r]));
+          }
+          R localAcc = a.add((R)2., in[index]);
+          localAcc = a.sub(localAcc, next[index]);
+          next[index] = a.add(localAcc, a.mul(div, vsq[index]));
+        }
+      }
+    }
+  }
+
+  static const int nbStep_ = 6;
+  static const int width_ = 4;
+  int n_;
+  std::vector<REAL> a0_;
+  std::vector<REAL> vsq_;
+};
+
+// recursive summation with cancellations, scalar ops or verrou_sum_*
+template <class REAL, bool KERNEL> class vr_benchSum {
+public:
+  static const char *name() { return KERNEL ? "sum_kernel" : "sum"; }
+  explicit vr_benchSum(double scale)
+      : x_(vr_benchInputVector<REAL>((size_t)(scale * (1 << 22)), 3, 10)) {}
+
+  template <class ARITH>
+  double run(const ARITH &a, std::vector<long double> &out) const {
+    typedef typename ARITH::Real R;
+    std::vector<R> x(x_.begin(), x_.end());
+    vr_benchTimer timer;
+    R acc;
+    if (KERNEL) {
+      acc = a.sum(x.data(), x.size());
+    } else {
+      acc = 0;
+      for (size_t i = 0; i < x.size(); i++)
+        acc = a.add(acc, x[i]);
+    }
+    double dt = timer.elapsed();
+    out.assign(1, acc);
+    return dt;
+  }
+
+private:
+  std::vector<REAL> x_;
+};
+
+// dot product, scalar ops or verrou_dot_*
+template <class REAL, bool KERNEL> class vr_benchDot {
+public:
+  static const char *name() { return KERNEL ? "dot_kernel" : "dot"; }
+  explicit vr_benchDot(double scale)
+      : x_(vr_benchInputVector<REAL>((size_t)(scale * (1 << 22)), 4, 5)),
+        y_(vr_benchInputVector<REAL>(x_.size(), 5, 5)) {}
+
+  template <class ARITH>
+  double run(const ARITH &a, std::vector<long double> &out) const {
+    typedef typename ARITH::Real R;
+    std::vector<R> x(x_.begin(), x_.end());
+    std::vector<R> y(y_.begin(), y_.end());
+    vr_benchTimer timer;
+    R acc;
+    if (KERNEL) {
+      acc = a.dot(x.data(), y.data(), x.size());
+    } else {
+      acc = 0;
+      for (size_t i = 0; i < x.size(); i++)
+        acc = a.add(acc, a.mul(x[i], y[i]));
+    }
+    double dt = timer.elapsed();
+    out.assign(1, acc);
+    return dt;
+  }
+
+private:
+  std::vector<REAL> x_;
+  std::vector<REAL> y_;
+};
+
+// conjugate gradient on the 1D Poisson matrix tridiag(-1,2,-1), run for n
+// iterations (exact convergence in exact arithmetic)
+template <class REAL> class vr_benchSolver {
+public:
+  static const char *name() { return "cg"; }
+  explicit vr_benchSolver(double scale)
+      : b_(vr_benchInputVector<REAL>(
+            std::max((size_t)16, (size_t)(512 * std::sqrt(scale))), 6, 0)) {}
+
+  template <class ARITH>
+  double run(const ARITH &a, std::vector<long double> &out) const {
+    typedef typename ARITH::Real R;
+    const size_t n = b_.size();
+    std::vector<R> x(n, (R)0), r(b_.begin(), b_.end()), p(r), q(n);
+    vr_benchTimer timer;
+    R rr = dot(a, r, r);
+    for (size_t it = 0; it < n && rr != (R)0; it++) {
+      for (size_t i = 0; i < n; i++) {
+        R qi = a.mul((R)2, p[i]);
+        if (i > 0)
+          qi = a.sub(qi, p[i - 1]);
+        if (i + 1 < n)
+          qi = a.sub(qi, p[i + 1]);
+        q[i] = qi;
+      }
+      const R alpha = a.div(rr, dot(a, p, q));
+      for (size_t i = 0; i < n; i++) {
+        x[i] = a.add(x[i], a.mul(alpha, p[i]));
+        r[i] = a.sub(r[i], a.mul(alpha, q[i]));
+      }
+      const R rrNew = dot(a, r, r);
+      const R beta = a.div(rrNew, rr);
+      for (size_t i = 0; i < n; i++)
+        p[i] = a.add(r[i], a.mul(beta, p[i]));
+      rr = rrNew;
+    }
+    double dt = timer.elapsed();
+    out.assign(x.begin(), x.end());
+    return dt;
+  }
+
+private:
+  template <class ARITH>
+  static typename ARITH::Real dot(const ARITH &a,
+                                  const std::vector<typename ARITH::Real> &x,
+                                  const std::vector<typename ARITH::Real> &y) {
+    typename ARITH::Real acc = 0;
+    for (size_t i = 0; i < x.size(); i++)
+      acc = a.add(acc, a.mul(x[i], y[i]));
+    return acc;
+  }
+
+  std::vector<REAL> b_;
+};
+
+// * Driver
+
+struct vr_benchConf {
+  double scale;
+  unsigned int nbSample;
+  bool runFloat;
+  bool runDouble;
+  bool runPointer; // results through pointers (interflop_verrou_init)
+  bool runValue;   // results by value (interflop_verrou_value_backend)
+  std::vector<std::string> workloads;
+};
+
+struct vr_benchRow {
+  std::string mode;
+  double time;
+  double error;
+};
+
+static double vr_benchError(const std::vector<long double> &res,
+                            const std::vector<long double> &ref) {
+  long double diff = 0, norm = 0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    diff += (res[i] - ref[i]) * (res[i] - ref[i]);
+    norm += ref[i] * ref[i];
+  }
+  if (norm == 0)
+    return (double)std::sqrt(diff);
+  return (double)std::sqrt(diff / norm);
+}
+
+static bool vr_benchSelected(const vr_benchConf &conf, const char *name) {
+  if (conf.workloads.empty())
+    return true;
+  return std::find(conf.workloads.begin(), conf.workloads.end(), name) !=
+         conf.workloads.end();
+}
+
+template <class WORKLOAD, class REAL>
+static void vr_benchRun(const vr_benchConf &conf, const char *typeName,
+                        void *context) {
+  if (!vr_benchSelected(conf, WORKLOAD::name()))
+    return;
+  const WORKLOAD w(conf.scale);
+
+  std::vector<long double> ref, res;
+  w.run(vr_benchNative<long double>(), ref);
+
+  std::vector<vr_benchRow> rows;
+  double timeNative = HUGE_VAL;
+  for (unsigned int s = 0; s < conf.nbSample; s++)
+    timeNative = std::min(timeNative, w.run(vr_benchNative<REAL>(), res));
+  rows.push_back({"uninstrumented", timeNative, vr_benchError(res, ref)});
+
+  // FTZ has no static backend
+  for (int m = VR_NEAREST; m < VR_FTZ; m++) {
+    const enum vr_RoundingMode mode = (enum vr_RoundingMode)m;
+    vr_benchRow row = {verrou_rounding_mode_name(mode), HUGE_VAL, 0.};
+    vr_benchRow rowValue = {row.mode + "/value", HUGE_VAL, 0.};
+    for (unsigned int s = 0; s < conf.nbSample; s++) {
+      verrou_conf_t vconf;
+      verrou_conf_init(&vconf);
+      vconf.default_rounding_mode = mode;
+      vconf.rounding_mode = mode;
+      vconf.naninf_mode = VR_NANINF_IGNORE;
+      vconf.random_engine =
+          ((const verrou_context_t *)context)->random_engine;
+      vconf.seed = 42 + s;
+      if (conf.runPointer) {
+        verrou_configure_all(&vconf, context);
+        const struct interflop_backend_interface_t backend =
+            interflop_verrou_init(context);
+        const vr_benchVerrou<REAL> a(backend, context);
+        row.time = std::min(row.time, w.run(a, res));
+        row.error = std::max(row.error, vr_benchError(res, ref));
+      }
+      if (conf.runValue) {
+        verrou_configure_all(&vconf, context);
+        interflop_verrou_init(context);
+        const vr_benchVerrouValue<REAL> a(
+            interflop_verrou_value_backend(context), context);
+        rowValue.time = std::min(rowValue.time, w.run(a, res));
+        rowValue.error = std::max(rowValue.error, vr_benchError(res, ref));
+      }
+    }
+    if (conf.runPointer)
+      rows.push_back(row);
+    if (conf.runValue)
+      rows.push_back(rowValue);
+  }
+
+  // sorted by cost: each row with a larger error than all the cheaper ones
+  // is on the accuracy versus cost Pareto front
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](const vr_benchRow &x, const vr_benchRow &y) {
+                     return x.time < y.time;
+                   });
+  double maxError = -1.;
+  for (const vr_benchRow &row : rows) {
+    const bool pareto = row.error > maxError;
+    maxError = std::max(maxError, row.error);
+    printf("%-12s %-6s %-20s %10.4g %10.4g %9.2f %12.4e %s\n", WORKLOAD::name(),
+           typeName, row.mode.c_str(), timeNative, row.time,
+           row.time / timeNative, row.error, pareto ? "*" : "");
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+template <class REAL>
+static void vr_benchRunType(const vr_benchConf &conf, const char *typeName,
+                            void *context) {
+  vr_benchRun<vr_benchStagnation<REAL>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchSum<REAL, false>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchSum<REAL, true>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchDot<REAL, false>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchDot<REAL, true>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchStencil<REAL>, REAL>(conf, typeName, context);
+  vr_benchRun<vr_benchSolver<REAL>, REAL>(conf, typeName, context);
+}
+
+int main(int argc, char **argv) {
+  vr_benchConf conf = {1., 3, true, true, true, false, {}};
+  vr_bench_set_handlers();
+  void *context;
+  interflop_verrou_pre_init((File *)stderr, vr_bench_panic, &context);
+  verrou_context_t *ctx = (verrou_context_t *)context;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--scale=", 8) == 0) {
+      conf.scale = atof(argv[i] + 8);
+    } else if (strncmp(argv[i], "--samples=", 10) == 0) {
+      conf.nbSample = std::max(1, atoi(argv[i] + 10));
+    } else if (strcmp(argv[i], "--type=float") == 0) {
+      conf.runDouble = false;
+    } else if (strcmp(argv[i], "--type=double") == 0) {
+      conf.runFloat = false;
+    } else if (strcmp(argv[i], "--abi=pointer") == 0) {
+      conf.runPointer = true;
+      conf.runValue = false;
+    } else if (strcmp(argv[i], "--abi=value") == 0) {
+      conf.runPointer = false;
+      conf.runValue = true;
+    } else if (strcmp(argv[i], "--abi=both") == 0) {
+      conf.runPointer = true;
+      conf.runValue = true;
+    } else if (strncmp(argv[i], "--random-engine=", 16) == 0) {
+      int e = VR_RAND_TINYMT64;
+      while (e <= VR_RAND_WYRAND &&
+             strcmp(argv[i] + 16,
+                    verrou_random_engine_name((enum vr_RandEngine)e)) != 0)
+        e++;
+      if (e > VR_RAND_WYRAND) {
+        fprintf(stderr, "unknown random engine: %s\n", argv[i] + 16);
+        return 1;
+      }
+      ctx->random_engine = (enum vr_RandEngine)e;
+    } else {
+      conf.workloads.push_back(argv[i]);
+    }
+  }
+
+  printf("# time: best of %u samples [s], overhead against uninstrumented, "
+         "error: max of the normwise relative errors, random engine: %s\n",
+         conf.nbSample, verrou_random_engine_name(ctx->random_engine));
+  printf("# workload   type   mode                 time_nat       time "
+         "overhead        error pareto\n");
+  if (conf.runDouble)
+    vr_benchRunType<double>(conf, "double", context);
+  if (conf.runFloat)
+    vr_benchRunType<float>(conf, "float", context);
+
+  interflop_verrou_finalize(context);
+  return 0;
+}
@@ -0,0 +1,14 @@
+# Common settings of the examples: the backend is compiled from the sources
+# of this tree and linked against the interflop-stdlib installed by
+# install-stdlib.sh (override INTERFLOP_STDLIB_PATH for another install).
+
+VERROU_DIR=$(dir $(lastword $(MAKEFILE_LIST)))..
+INTERFLOP_STDLIB_PATH?=$(VERROU_DIR)/interflop-stdlib/install
+
+SRC_VERROU=$(VERROU_DIR)/interflop_verrou.cxx
+VERROU_DET_HASH?=double_tabulation
+VERROU_NUM_AVG?=1
+
+FLAGS_VERROU=-I$(INTERFLOP_STDLIB_PATH)/include -DVERROU_NUM_AVG=$(VERROU_NUM_AVG) -fno-math-errno
+HASH_VERROU=-DVERROU_DET_HASH=vr_$(VERROU_DET_HASH)_hash
+LIBS_VERROU=-L$(INTERFLOP_STDLIB_PATH)/lib -Wl,-rpath,$(INTERFLOP_STDLIB_PATH)/lib -linterflop_stdlib -linterflop_prng -linterflop_fma -lpthread
@@ -30,8 +30,19 @@
    The GNU Lesser General Public License is contained in the file COPYING.
 */
 
+#include <algorithm>
 #include <argp.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gnu/lib-names.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "vr_rand.h"
 
@@ -39,27 +50,136 @@
 #include "interflop-stdlib/interflop_stdlib.h"
 #include "interflop_verrou.h"
 #include "static_backends.hxx"
+#include "vr_control.hxx"
+#include "vr_kernels.hxx"
+#include "vr_libm.hxx"
 #include "vr_nextUlp.hxx"
 #include "vr_op.hxx"
+#include "vr_reduction.hxx"
 #include "vr_roundingOp.hxx"
+#include "vr_shadow.hxx"
 
 // * Global variables & parameters
 int CHECK_C = 0;
 vr_RoundingMode DEFAULTROUNDINGMODE;
 vr_RoundingMode ROUNDINGMODE;
-unsigned int vr_seed;
+uint64_t vr_seed;
+#ifdef VR_RUNTIME_FMA
+bool vr_hardwareFma = false;
+#endif
+#ifdef VR_HARDWARE_ROUNDING
+bool vr_hardwareEmbeddedRounding = false;
+#endif
 
-static File *stderr_stream;
+verrou_control_t *vr_control = NULL;
+__thread vr_controlThread_t vr_controlThread
+    __attribute__((tls_model("initial-exec")));
+static uint64_t vr_controlSequence = 0;
+static uint64_t vr_controlSeed;
+static pthread_key_t vr_controlKey;
+static pthread_once_t vr_controlKeyOnce = PTHREAD_ONCE_INIT;
+
+__thread vr_windowThread_t vr_windowThread
+    __attribute__((tls_model("initial-exec")));
+// sorted ranges [begin, end) of op indices
+static uint64_t vr_windowBegin[VR_WINDOW_NB_RANGE];
+static uint64_t vr_windowEnd[VR_WINDOW_NB_RANGE];
+static int vr_windowNbRange = 0;
+// or one window of vr_windowLength ops out of every vr_windowPeriod ones,
+// starting with the window vr_windowPhase
+static uint64_t vr_windowLength = 0;
+static uint64_t vr_windowPeriod;
+static uint64_t vr_windowPhase;
+
+// bit OP::getHash() set for the ops perturbed (--instr-ops)
+#define VR_INSTR_OPS_ALL ((1U << VERROU_CONTROL_NB_OP) - 1)
+static uint32_t vr_instrOps = VR_INSTR_OPS_ALL;
+
+typedef struct {
+  int nbArgs;
+  double args[3];
+  double res;
+} vr_nanInfRecord_t;
+static uint64_t vr_nanCount[nbOpHash * nbTypeHash];
+static uint64_t vr_infCount[nbOpHash * nbTypeHash];
+// first occurrence of NaN and Inf for each op and type
+// first VR_NANINF_NB_RECORD occurrences of NaN and Inf for each op and type
+#define VR_NANINF_NB_RECORD 4
+static vr_nanInfRecord_t vr_firstNan[nbOpHash * nbTypeHash]
+                                    [VR_NANINF_NB_RECORD];
+static vr_nanInfRecord_t vr_firstInf[nbOpHash * nbTypeHash]
+                                    [VR_NANINF_NB_RECORD];
+
+static int vr_forkSample = -1;
+static uint64_t vr_forkBaseSeed;
+
+__thread verrou_context_t *vr_threadContext
+    __attribute__((tls_model("initial-exec"))) = NULL;
+
+static verrou_store_t *vr_store = NULL;
+static size_t vr_storeMapSize;
+
+typedef struct {
+  char name[VERROU_SHADOW_NAME_SIZE];
+  uint64_t nbCall;
+  uint64_t nbValue;
+  double maxError; // largest relative error of the values
+  double sumError; // of the largest relative error of each call
+} vr_shadowCheckpoint_t;
+static vr_shadowCheckpoint_t vr_shadowCheckpoints[VERROU_SHADOW_NB_CHECKPOINT];
+static int vr_shadowNbCheckpoint = 0;
+static uint32_t vr_shadowLock = 0;
 
-#if defined(__cplusplus)
-extern "C" {
-#endif
+static File *stderr_stream;
 
 #ifdef PROFILING_EXACT
 unsigned int vr_NumOp;
 unsigned int vr_NumExactOp;
 #endif
 
+#ifdef PROFILING_EVENTS
+__thread vr_eventTable_t *vr_eventThreadTable
+    __attribute__((tls_model("initial-exec")));
+// tables of all threads, merged at finalize
+static vr_eventTable_t *vr_eventTables = NULL;
+#endif
+
+#ifdef VERROU_LIBM
+// context of the last init, for the libm entry points
+static void *vr_libmContext = NULL;
+vr_libmNative_t vr_libmNative;
+bool vr_libmNativeReady = false;
+static pthread_once_t vr_libmNativeOnce = PTHREAD_ONCE_INIT;
+#endif
+
+// log10 of the reports, past the interposer of the libm
+static inline double _verrou_log10(double x) {
+#ifdef VERROU_LIBM
+  return vr_libm_native().log10(x);
+#else
+  return __builtin_log10(x);
+#endif
+}
+
+#ifdef PROFILING_SITES
+__thread vr_siteTable_t *vr_siteThreadTable
+    __attribute__((tls_model("initial-exec")));
+// tables of all threads, merged at finalize
+static vr_siteTable_t *vr_siteTables = NULL;
+#define VR_SITE_INITIAL_CAPACITY 1024
+#endif
+
+#if VERROU_DET_HASH_CACHE > 0
+__thread vr_detHashCache_t *vr_detHashThreadCache
+    __attribute__((tls_model("initial-exec")));
+// caches of all threads, for the hit and miss counts
+static vr_detHashCache_t *vr_detHashCaches = NULL;
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
 void verrou_init_profiling_exact(void) {
 #ifdef PROFILING_EXACT
   vr_NumOp = 0;
@@ -74,6 +194,418 @@ void verrou_get_profiling_exact(unsigned int *num, unsigned int *numExact) {
 #endif
 }
 
+#ifdef PROFILING_EVENTS
+vr_eventTable_t *vr_event_table_alloc(void) {
+  vr_eventTable_t *table =
+      (vr_eventTable_t *)interflop_calloc(1, sizeof(vr_eventTable_t));
+  table->next = __atomic_load_n(&vr_eventTables, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&vr_eventTables, &table->next, table,
+                                      true, __ATOMIC_RELEASE,
+                                      __ATOMIC_RELAXED)) {
+  }
+  vr_eventThreadTable = table;
+  return table;
+}
+
+// sum of the tables of all threads
+static void _verrou_event_merge(vr_eventTable_t *merged) {
+  for (vr_eventTable_t *table =
+           __atomic_load_n(&vr_eventTables, __ATOMIC_ACQUIRE);
+       table != NULL; table = table->next) {
+    for (int i = 0; i < nbOpHash * nbTypeHash; i++) {
+      merged->numOp[i] += table->numOp[i];
+      for (int j = 0; j < VR_CANCELLATION_NB_BIN; j++) {
+        merged->cancellation[i][j] += table->cancellation[i][j];
+      }
+      merged->absorption[i] += table->absorption[i];
+      merged->subnormalIn[i] += table->subnormalIn[i];
+      merged->subnormalOut[i] += table->subnormalOut[i];
+    }
+  }
+}
+#endif
+
+void verrou_init_profiling_events(void) {
+#ifdef PROFILING_EVENTS
+  for (vr_eventTable_t *table =
+           __atomic_load_n(&vr_eventTables, __ATOMIC_ACQUIRE);
+       table != NULL; table = table->next) {
+    vr_eventTable_t *next = table->next;
+    __builtin_memset(table, 0, sizeof(vr_eventTable_t));
+    table->next = next;
+  }
+#endif
+}
+
+static const char *_verrou_op_hash_name(uint32_t opHash);
+
+#ifdef PROFILING_SITES
+// slot of site in table: the entry of site or the empty slot ending its probe
+static vr_siteEntry_t *_verrou_site_slot(vr_siteTable_t *table,
+                                         uintptr_t site) {
+  const uint64_t mask = table->capacity - 1;
+  uint64_t i = (site * 0x9E3779B97F4A7C15ULL) >> 32;
+  for (;; i++) {
+    vr_siteEntry_t *entry = &table->entries[i & mask];
+    if (entry->site == site || entry->site == 0) {
+      return entry;
+    }
+  }
+}
+
+static void _verrou_site_table_alloc(vr_siteTable_t *table,
+                                     uint64_t capacity) {
+  table->entries =
+      (vr_siteEntry_t *)interflop_calloc(capacity, sizeof(vr_siteEntry_t));
+  table->capacity = capacity;
+  table->size = 0;
+}
+
+// load factor kept under 1/2. The old entries are not freed: they may be
+// read concurrently by verrou_print_profiling_sites.
+static void _verrou_site_table_grow(vr_siteTable_t *table) {
+  vr_siteEntry_t *entries = table->entries;
+  const uint64_t capacity = table->capacity;
+  vr_siteTable_t grown;
+  _verrou_site_table_alloc(&grown, 2 * capacity);
+  for (uint64_t i = 0; i < capacity; i++) {
+    if (entries[i].site != 0) {
+      *_verrou_site_slot(&grown, entries[i].site) = entries[i];
+      grown.size++;
+    }
+  }
+  table->capacity = grown.capacity;
+  table->size = grown.size;
+  __atomic_store_n(&table->entries, grown.entries, __ATOMIC_RELEASE);
+}
+
+vr_siteEntry_t *vr_site_insert(uintptr_t site, uint32_t op) {
+  vr_siteTable_t *table = vr_siteThreadTable;
+  if (table == NULL) {
+    table = (vr_siteTable_t *)interflop_calloc(1, sizeof(vr_siteTable_t));
+    _verrou_site_table_alloc(table, VR_SITE_INITIAL_CAPACITY);
+    table->next = __atomic_load_n(&vr_siteTables, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&vr_siteTables, &table->next, table,
+                                        true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    vr_siteThreadTable = table;
+  }
+  if (2 * (table->size + 1) > table->capacity) {
+    _verrou_site_table_grow(table);
+  }
+  vr_siteEntry_t *entry = _verrou_site_slot(table, site);
+  if (entry->site == 0) {
+    entry->site = site;
+    entry->op = op;
+#ifdef PROFILING_PRECISION
+    entry->minExp = INT32_MAX;
+    entry->maxExp = INT32_MIN;
+#endif
+    table->size++;
+  }
+  return entry;
+}
+
+static bool _verrou_site_cmp(const vr_siteEntry_t &a, const vr_siteEntry_t &b) {
+  return a.nbOp > b.nbOp;
+}
+
+static const char *_verrou_hex(const char *str, uint64_t *value) {
+  *value = 0;
+  for (;; str++) {
+    const char c = *str;
+    if (c >= '0' && c <= '9') {
+      *value = *value * 16 + (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      *value = *value * 16 + (c - 'a' + 10);
+    } else {
+      return str;
+    }
+  }
+}
+
+// whole content of /proc/self/maps, NULL on failure
+static char *_verrou_read_maps(void) {
+  const int fd = open("/proc/self/maps", O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  size_t size = 0;
+  size_t capacity = 1 << 16;
+  char *maps = (char *)interflop_malloc(capacity);
+  for (;;) {
+    if (size + 1 == capacity) {
+      char *larger = (char *)interflop_malloc(2 * capacity);
+      for (size_t i = 0; i < size; i++) {
+        larger[i] = maps[i];
+      }
+      interflop_free(maps);
+      maps = larger;
+      capacity *= 2;
+    }
+    const ssize_t n = read(fd, maps + size, capacity - 1 - size);
+    if (n <= 0) {
+      break;
+    }
+    size += n;
+  }
+  close(fd);
+  maps[size] = '\0';
+  return maps;
+}
+
+// next field of a line of /proc/self/maps
+static const char *_verrou_maps_field(const char *str) {
+  while (*str != ' ' && *str != '\n' && *str != '\0') {
+    str++;
+  }
+  while (*str == ' ') {
+    str++;
+  }
+  return str;
+}
+
+// prints the object file mapped at address and the offset of address in it,
+// for addr2line
+static void _verrou_print_site_object(const char *maps, uintptr_t address) {
+  const char *line = maps;
+  while (*line != '\0') {
+    uint64_t begin, end, offset;
+    const char *str = _verrou_hex(line, &begin);
+    _verrou_hex(str + 1, &end);
+    // begin-end perms offset dev inode [path]
+    str = _verrou_maps_field(line);
+    str = _verrou_maps_field(str);
+    _verrou_hex(str, &offset);
+    for (int i = 0; i < 3; i++) {
+      str = _verrou_maps_field(str);
+    }
+    const char *eol = str;
+    while (*eol != '\n' && *eol != '\0') {
+      eol++;
+    }
+    if (begin <= address && address < end) {
+      interflop_fprintf(stderr_stream, " (%.*s+0x%lx)", (int)(eol - str), str,
+                        address - begin + offset);
+      return;
+    }
+    line = *eol == '\0' ? eol : eol + 1;
+  }
+}
+// merge of the tables of all threads, packed at the beginning of
+// merged->entries: returns the number of sites
+static uint64_t _verrou_site_merge(vr_siteTable_t *merged) {
+  _verrou_site_table_alloc(merged, VR_SITE_INITIAL_CAPACITY);
+  vr_siteTable_t *tables = __atomic_load_n(&vr_siteTables, __ATOMIC_ACQUIRE);
+  for (vr_siteTable_t *table = tables; table != NULL; table = table->next) {
+    vr_siteEntry_t *entries =
+        __atomic_load_n(&table->entries, __ATOMIC_ACQUIRE);
+    const uint64_t capacity = table->capacity;
+    for (uint64_t i = 0; i < capacity; i++) {
+      if (entries[i].site == 0 || entries[i].nbOp == 0) {
+        continue;
+      }
+      if (2 * (merged->size + 1) > merged->capacity) {
+        vr_siteEntry_t *old = merged->entries;
+        _verrou_site_table_grow(merged);
+        interflop_free(old);
+      }
+      vr_siteEntry_t *entry = _verrou_site_slot(merged, entries[i].site);
+      if (entry->site == 0) {
+        *entry = entries[i];
+        merged->size++;
+      } else {
+        entry->nbOp += entries[i].nbOp;
+        entry->nbInexact += entries[i].nbInexact;
+        entry->nbMoved += entries[i].nbMoved;
+#ifdef PROFILING_PRECISION
+        entry->minExp = std::min(entry->minExp, entries[i].minExp);
+        entry->maxExp = std::max(entry->maxExp, entries[i].maxExp);
+        entry->nbDouble += entries[i].nbDouble;
+        entry->nbFloatDiff += entries[i].nbFloatDiff;
+#endif
+      }
+    }
+  }
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < merged->capacity; i++) {
+    if (merged->entries[i].site != 0) {
+      merged->entries[size++] = merged->entries[i];
+    }
+  }
+  return size;
+}
+#endif
+
+void verrou_init_profiling_sites(void) {
+#ifdef PROFILING_SITES
+  vr_siteTable_t *tables = __atomic_load_n(&vr_siteTables, __ATOMIC_ACQUIRE);
+  for (vr_siteTable_t *table = tables; table != NULL; table = table->next) {
+    vr_siteEntry_t *entries =
+        __atomic_load_n(&table->entries, __ATOMIC_ACQUIRE);
+    for (uint64_t i = 0; i < table->capacity; i++) {
+      entries[i].nbOp = 0;
+      entries[i].nbInexact = 0;
+      entries[i].nbMoved = 0;
+#ifdef PROFILING_PRECISION
+      entries[i].minExp = INT32_MAX;
+      entries[i].maxExp = INT32_MIN;
+      entries[i].nbDouble = 0;
+      entries[i].nbFloatDiff = 0;
+#endif
+    }
+  }
+#endif
+}
+
+void verrou_print_profiling_sites(void) {
+#ifdef PROFILING_SITES
+  vr_siteTable_t merged;
+  const uint64_t size = _verrou_site_merge(&merged);
+  if (size == 0) {
+    interflop_free(merged.entries);
+    return;
+  }
+  std::sort(merged.entries, merged.entries + size, _verrou_site_cmp);
+
+  char *maps = _verrou_read_maps();
+  interflop_fprintf(stderr_stream, "VERROU sites (%lu):\n", size);
+  for (uint64_t i = 0; i < size; i++) {
+    const vr_siteEntry_t *entry = &merged.entries[i];
+    interflop_fprintf(stderr_stream,
+                      "  %s: %lu ops, %lu inexact, %lu moved, at 0x%lx",
+                      _verrou_op_hash_name(entry->op), entry->nbOp,
+                      entry->nbInexact, entry->nbMoved, entry->site);
+    if (maps != NULL) {
+      _verrou_print_site_object(maps, entry->site);
+    }
+    interflop_fprintf(stderr_stream, "\n");
+  }
+  if (maps != NULL) {
+    interflop_free(maps);
+  }
+  interflop_free(merged.entries);
+#endif
+}
+
+#ifdef PROFILING_PRECISION
+// normal range of float: the demoted values must not overflow nor lose bits
+#define VR_FLOAT_MIN_EXP (-126)
+#define VR_FLOAT_MAX_EXP 127
+
+static bool _verrou_site_float_range(const vr_siteEntry_t &entry) {
+  return entry.minExp >= VR_FLOAT_MIN_EXP && entry.maxExp <= VR_FLOAT_MAX_EXP;
+}
+
+static double _verrou_site_float_diff(const vr_siteEntry_t &entry) {
+  return (double)entry.nbFloatDiff / (double)entry.nbDouble;
+}
+
+// safest first: in the range of float, then the fewest float results beyond
+// the tolerance, then the most ops
+static bool _verrou_precision_cmp(const vr_siteEntry_t &a,
+                                  const vr_siteEntry_t &b) {
+  const bool rangeA = _verrou_site_float_range(a);
+  const bool rangeB = _verrou_site_float_range(b);
+  if (rangeA != rangeB) {
+    return rangeA;
+  }
+  const double diffA = _verrou_site_float_diff(a);
+  const double diffB = _verrou_site_float_diff(b);
+  if (diffA != diffB) {
+    return diffA < diffB;
+  }
+  return a.nbOp > b.nbOp;
+}
+#endif
+
+void verrou_print_precision_advice(void) {
+#ifdef PROFILING_PRECISION
+  vr_siteTable_t merged;
+  const uint64_t nbSite = _verrou_site_merge(&merged);
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < nbSite; i++) {
+    if (merged.entries[i].nbDouble != 0) {
+      merged.entries[size++] = merged.entries[i];
+    }
+  }
+  if (size == 0) {
+    interflop_free(merged.entries);
+    return;
+  }
+  std::sort(merged.entries, merged.entries + size, _verrou_precision_cmp);
+
+  char *maps = _verrou_read_maps();
+  interflop_fprintf(stderr_stream,
+                    "VERROU precision advice (%lu double sites, tolerance "
+                    "%g), from the safest to demote to float:\n",
+                    size, VERROU_PRECISION_TOLERANCE);
+  for (uint64_t i = 0; i < size; i++) {
+    const vr_siteEntry_t *entry = &merged.entries[i];
+    const char *verdict = "safe";
+    if (!_verrou_site_float_range(*entry)) {
+      verdict = "range";
+    } else if (entry->nbFloatDiff != 0) {
+      verdict = "accuracy";
+    }
+    interflop_fprintf(stderr_stream,
+                      "  %-8s %s: %lu ops, %.3g%% beyond tolerance, "
+                      "exponents [%d, %d], at 0x%lx",
+                      verdict, _verrou_op_hash_name(entry->op),
+                      entry->nbDouble, 100. * _verrou_site_float_diff(*entry),
+                      entry->minExp, entry->maxExp, entry->site);
+    if (maps != NULL) {
+      _verrou_print_site_object(maps, entry->site);
+    }
+    interflop_fprintf(stderr_stream, "\n");
+  }
+  if (maps != NULL) {
+    interflop_free(maps);
+  }
+  interflop_free(merged.entries);
+#endif
+}
+
+void verrou_print_profiling_events(void) {
+#ifdef PROFILING_EVENTS
+  vr_eventTable_t *merged =
+      (vr_eventTable_t *)interflop_calloc(1, sizeof(vr_eventTable_t));
+  _verrou_event_merge(merged);
+  bool header = false;
+  for (int i = 0; i < nbOpHash * nbTypeHash; i++) {
+    if (merged->numOp[i] == 0) {
+      continue;
+    }
+    if (!header) {
+      interflop_fprintf(stderr_stream,
+                        "VERROU events (cancellation threshold: %d bits):\n",
+                        VERROU_CANCELLATION_THRESHOLD);
+      header = true;
+    }
+    uint64_t nbCancellation = 0;
+    for (int j = VERROU_CANCELLATION_THRESHOLD + 1; j < VR_CANCELLATION_NB_BIN;
+         j++) {
+      nbCancellation += merged->cancellation[i][j];
+    }
+    interflop_fprintf(stderr_stream,
+                      "  %s: %lu ops, %lu cancellations, %lu absorptions, "
+                      "%lu subnormal inputs, %lu subnormal outputs\n",
+                      _verrou_op_hash_name(i), merged->numOp[i],
+                      nbCancellation, merged->absorption[i],
+                      merged->subnormalIn[i], merged->subnormalOut[i]);
+    for (int j = 1; j < VR_CANCELLATION_NB_BIN; j++) {
+      if (merged->cancellation[i][j] != 0) {
+        interflop_fprintf(stderr_stream, "    lost bits %s%2d: %lu\n",
+                          j == VR_CANCELLATION_NB_BIN - 1 ? ">=" : "", j,
+                          merged->cancellation[i][j]);
+      }
+    }
+  }
+  interflop_free(merged);
+#endif
+}
+
 // * Operation implementation
 const char *verrou_rounding_mode_name(enum vr_RoundingMode mode) {
   switch (mode) {
@@ -116,6 +648,29 @@ const char *verrou_rounding_mode_name(enum vr_RoundingMode mode) {
   return "undefined";
 }
 
+const char *verrou_random_engine_name(enum vr_RandEngine engine) {
+  switch (engine) {
+  case VR_RAND_TINYMT64:
+    return "tinymt64";
+  case VR_RAND_XOSHIRO256:
+    return "xoshiro256+";
+  case VR_RAND_SFC64:
+    return "sfc64";
+  case VR_RAND_WYRAND:
+    return "wyrand";
+  }
+
+  return "undefined";
+}
+
+static void _verrou_set_seed(uint64_t seed) {
+  Vr_Rand *rand = vr_boundRand();
+  if (rand == &vr_rand) {
+    vr_seed = vr_rand_next(&vr_rand);
+  }
+  vr_rand_setSeed(rand, seed);
+}
+
 void interflop_set_seed(u_int64_t seed, void *context) {
   verrou_context_t *ctx = (verrou_context_t *)context;
   ROUNDINGMODE = ctx->rounding_mode;
@@ -127,17 +682,17 @@ void interflop_set_seed(u_int64_t seed, void *context) {
     interflop_gettimeofday(&t1, NULL);
     vr_seed = t1.tv_usec + interflop_gettid();
   }
-  verrou_set_seed(vr_seed);
+  _verrou_set_seed(vr_seed);
 }
 
 void verrou_updatep_prandom(void) {
-  const double p = tinymt64_generate_double(&(vr_rand.gen_));
-  vr_rand.p = p;
+  Vr_Rand *rand = vr_boundRand();
+  rand->p = vr_rand_double(rand);
 }
 
-void verrou_updatep_prandom_double(double p) { vr_rand.p = p; }
+void verrou_updatep_prandom_double(double p) { vr_boundRand()->p = p; }
 
-double verrou_prandom_pvalue(void) { return vr_rand.p; }
+double verrou_prandom_pvalue(void) { return vr_boundRand()->p; }
 
 // * C interface
 void INTERFLOP_VERROU_API(configure)(verrou_conf_t conf, void *context) {
@@ -148,6 +703,16 @@ void INTERFLOP_VERROU_API(configure)(verrou_conf_t conf, void *context) {
   interflop_set_seed(conf.seed, context);
 }
 
+void verrou_configure_all(const verrou_conf_t *conf, void *context) {
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  // the generator belongs to the context, not to the configuration
+  struct Vr_Rand_ *rand = ctx->rand;
+  *ctx = *conf;
+  ctx->rand = rand;
+  vr_seed = conf->seed;
+  interflop_set_seed(conf->seed, context);
+}
+
 const char *INTERFLOP_VERROU_API(get_backend_name)() { return "verrou"; }
 
 const char *INTERFLOP_VERROU_API(get_backend_version)() { return "1.x-dev"; }
@@ -162,14 +727,604 @@ void verrou_end_instr(void *context) {
   ctx->rounding_mode = VR_NEAREST;
 }
 
-void verrou_set_seed(unsigned int seed) {
-  vr_seed = vr_rand_next(&vr_rand);
-  vr_rand_setSeed(&vr_rand, seed);
-}
+void verrou_set_seed(unsigned int seed) { _verrou_set_seed(seed); }
 
 void verrou_set_random_seed() { vr_rand_setSeed(&vr_rand, vr_seed); }
 
-#define IFV_INLINE inline
+// * NaN/Inf reporting
+static void _verrou_set_record(vr_nanInfRecord_t *record, int nbArgs,
+                               const double *args, double res) {
+  record->nbArgs = nbArgs;
+  for (int i = 0; i < nbArgs; i++) {
+    record->args[i] = args[i];
+  }
+  record->res = res;
+}
+
+void vr_nanInfRecord(uint32_t opHash, int nbArgs, const double *args,
+                     double res) {
+  if (isNan(res)) {
+    const uint64_t count = vr_nanCount[opHash]++;
+    if (count < VR_NANINF_NB_RECORD) {
+      _verrou_set_record(&vr_firstNan[opHash][count], nbArgs, args, res);
+    }
+  } else {
+    const uint64_t count = vr_infCount[opHash]++;
+    if (count < VR_NANINF_NB_RECORD) {
+      _verrou_set_record(&vr_firstInf[opHash][count], nbArgs, args, res);
+    }
+  }
+}
+
+static const char *_verrou_op_hash_name(uint32_t opHash) {
+  static const char *names[nbOpHash * nbTypeHash] = {
+      "add_float",  "add_double",  "add_other",  "sub_float",  "sub_double",
+      "sub_other",  "mul_float",   "mul_double", "mul_other",  "div_float",
+      "div_double", "div_other",   "fma_float",  "fma_double", "fma_other",
+      "cast_float", "cast_double", "cast_other"};
+  return names[opHash];
+}
+
+static void _verrou_report_record(const char *kind, uint32_t opHash,
+                                  uint64_t count,
+                                  const vr_nanInfRecord_t *records) {
+  if (count == 0) {
+    return;
+  }
+  const uint64_t nbRecord = std::min<uint64_t>(count, VR_NANINF_NB_RECORD);
+  interflop_fprintf(stderr_stream, "  %s %s: %lu, first %lu:\n", kind,
+                    _verrou_op_hash_name(opHash), count, nbRecord);
+  for (uint64_t r = 0; r < nbRecord; r++) {
+    const vr_nanInfRecord_t *record = &records[r];
+    interflop_fprintf(stderr_stream, "    %s(", _verrou_op_hash_name(opHash));
+    for (int i = 0; i < record->nbArgs; i++) {
+      interflop_fprintf(stderr_stream, i == 0 ? "%.17g" : ", %.17g",
+                        record->args[i]);
+    }
+    interflop_fprintf(stderr_stream, ") = %.17g\n", record->res);
+  }
+}
+
+static void _verrou_report_naninf(void) {
+  bool header = false;
+  for (uint32_t i = 0; i < nbOpHash * nbTypeHash; i++) {
+    if (vr_nanCount[i] == 0 && vr_infCount[i] == 0) {
+      continue;
+    }
+    if (!header) {
+      interflop_fprintf(stderr_stream, "VERROU NaN/Inf report:\n");
+      header = true;
+    }
+    _verrou_report_record("NaN", i, vr_nanCount[i], vr_firstNan[i]);
+    _verrou_report_record("Inf", i, vr_infCount[i], vr_firstInf[i]);
+  }
+}
+
+#if VERROU_DET_HASH_CACHE > 0
+vr_detHashCache_t *vr_det_hash_cache_alloc(void) {
+  vr_detHashCache_t *cache =
+      (vr_detHashCache_t *)interflop_calloc(1, sizeof(vr_detHashCache_t));
+  cache->next = __atomic_load_n(&vr_detHashCaches, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&vr_detHashCaches, &cache->next, cache,
+                                      true, __ATOMIC_RELEASE,
+                                      __ATOMIC_RELAXED)) {
+  }
+  vr_detHashThreadCache = cache;
+  return cache;
+}
+#endif
+
+static void _verrou_report_det_hash_cache(void) {
+#if VERROU_DET_HASH_CACHE > 0
+  uint64_t nbHit = 0;
+  uint64_t nbMiss = 0;
+  for (vr_detHashCache_t *cache =
+           __atomic_load_n(&vr_detHashCaches, __ATOMIC_ACQUIRE);
+       cache != NULL; cache = cache->next) {
+    nbHit += cache->nbHit;
+    nbMiss += cache->nbMiss;
+  }
+  if (nbHit + nbMiss != 0) {
+    interflop_fprintf(stderr_stream,
+                      "VERROU det hash cache: %lu hits, %lu misses\n", nbHit,
+                      nbMiss);
+  }
+#endif
+}
+
+// * Fork server
+uint64_t verrou_derive_seed(uint64_t seed, unsigned int sample) {
+  return vr_rand_mix64(seed ^ vr_rand_mix64(sample));
+}
+
+static void _verrou_atfork_child(void) {
+  if (vr_forkSample < 0) {
+    return;
+  }
+  // the control block and its counters belong to the parent
+  vr_control = NULL;
+  _verrou_set_seed(verrou_derive_seed(vr_forkBaseSeed, vr_forkSample));
+}
+
+// only the samples are waited for: the other children of the application
+// are left to it
+static unsigned int _verrou_wait_sample(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return 1;
+    }
+  }
+  return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int verrou_fork_samples(unsigned int nb_samples, unsigned int nb_parallel,
+                        unsigned int *nb_failed) {
+  static bool atforkRegistered = false;
+  if (!atforkRegistered) {
+    pthread_atfork(NULL, NULL, _verrou_atfork_child);
+    atforkRegistered = true;
+  }
+  if (nb_parallel == 0 || nb_parallel > nb_samples) {
+    nb_parallel = nb_samples;
+  }
+
+  vr_forkBaseSeed = vr_rand_getSeed(&vr_rand);
+  // running samples, oldest first, in a ring of nb_parallel pids
+  pid_t *pids = (pid_t *)interflop_malloc((nb_parallel + 1) * sizeof(pid_t));
+  unsigned int first = 0;
+  unsigned int running = 0;
+  unsigned int failed = 0;
+  for (unsigned int sample = 0; sample < nb_samples; sample++) {
+    if (running == nb_parallel) {
+      failed += _verrou_wait_sample(pids[first]);
+      first = (first + 1) % nb_parallel;
+      running--;
+    }
+    vr_forkSample = sample;
+    const pid_t pid = fork();
+    vr_forkSample = -1;
+    if (pid == 0) {
+      interflop_free(pids);
+      return sample;
+    }
+    if (pid < 0) {
+      interflop_fprintf(stderr_stream, "Unable to fork sample %u\n", sample);
+      failed++;
+      continue;
+    }
+    pids[(first + running) % nb_parallel] = pid;
+    running++;
+  }
+  while (running > 0) {
+    failed += _verrou_wait_sample(pids[first]);
+    first = (first + 1) % nb_parallel;
+    running--;
+  }
+  interflop_free(pids);
+
+  if (nb_failed != NULL) {
+    *nb_failed = failed;
+  }
+  return VERROU_FORK_PARENT;
+}
+
+// * Result store
+#define VR_STORE_MAX_DIGITS 15.95 // 53 bits
+#define VR_STORE_WAIT_US 1000
+#define VR_STORE_WAIT_NB 1000
+
+static void _verrou_store_lock(uint32_t *lock) {
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    sched_yield();
+  }
+}
+
+static void _verrou_store_unlock(uint32_t *lock) {
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static size_t _verrou_store_size(uint64_t capacity) {
+  return sizeof(verrou_store_t) + capacity * sizeof(verrou_store_element_t);
+}
+
+static verrou_store_element_t *_verrou_store_elements(void) {
+  return (verrou_store_element_t *)(vr_store + 1);
+}
+
+// -log10 of the relative standard deviation of the samples
+static double _verrou_store_digits(double mean, double m2,
+                                   uint64_t nbSample) {
+  if (nbSample < 2 || !(m2 > 0.)) {
+    return VR_STORE_MAX_DIGITS;
+  }
+  const double stddev = __builtin_sqrt(m2 / (double)(nbSample - 1));
+  const double digits = -_verrou_log10(stddev / __builtin_fabs(mean));
+  if (digits > VR_STORE_MAX_DIGITS) {
+    return VR_STORE_MAX_DIGITS;
+  }
+  return digits > 0. ? digits : 0.;
+}
+
+// maps the store created by another process, once it is initialized
+static void *_verrou_store_attach(int fd, const char *path) {
+  struct stat st;
+  for (int i = 0;; i++) {
+    if (fstat(fd, &st) != 0 || i == VR_STORE_WAIT_NB) {
+      return MAP_FAILED;
+    }
+    if (st.st_size != 0) {
+      break; // set at once by ftruncate
+    }
+    usleep(VR_STORE_WAIT_US);
+  }
+  void *block = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+  if (block == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  verrou_store_t *store = (verrou_store_t *)block;
+  for (int i = 0; __atomic_load_n(&store->magic, __ATOMIC_ACQUIRE) !=
+                  VERROU_STORE_MAGIC;
+       i++) {
+    if (i == VR_STORE_WAIT_NB) {
+      munmap(block, st.st_size);
+      return MAP_FAILED;
+    }
+    usleep(VR_STORE_WAIT_US);
+  }
+  if (store->version != VERROU_STORE_VERSION ||
+      (size_t)st.st_size != _verrou_store_size(store->capacity)) {
+    interflop_fprintf(stderr_stream, "Incompatible result store %s\n", path);
+    munmap(block, st.st_size);
+    return MAP_FAILED;
+  }
+  vr_storeMapSize = st.st_size;
+  return block;
+}
+
+int verrou_store_open(const char *path, size_t capacity) {
+  verrou_store_close();
+  const size_t size = _verrou_store_size(capacity);
+  void *block;
+  bool create = true;
+  if (path == NULL) {
+    block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  } else {
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+      fd = open(path, O_RDWR);
+      create = false;
+    }
+    if (fd < 0) {
+      interflop_fprintf(stderr_stream, "Unable to open result store %s\n",
+                        path);
+      return -1;
+    }
+    if (!create) {
+      block = _verrou_store_attach(fd, path);
+    } else if (ftruncate(fd, size) != 0) {
+      block = MAP_FAILED;
+    } else {
+      block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+  }
+  if (block == MAP_FAILED) {
+    interflop_fprintf(stderr_stream, "Unable to map result store %s\n",
+                      path == NULL ? "(anonymous)" : path);
+    return -1;
+  }
+
+  vr_store = (verrou_store_t *)block;
+  if (create) {
+    // the mapping is zeroed: no array, unlocked
+    vr_storeMapSize = size;
+    vr_store->capacity = capacity;
+    vr_store->version = VERROU_STORE_VERSION;
+    __atomic_store_n(&vr_store->magic, VERROU_STORE_MAGIC, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+void verrou_store_close(void) {
+  if (vr_store != NULL) {
+    munmap(vr_store, vr_storeMapSize);
+    vr_store = NULL;
+  }
+}
+
+static verrou_store_array_t *_verrou_store_find(const char *name) {
+  const uint32_t nbArray =
+      __atomic_load_n(&vr_store->nb_array, __ATOMIC_ACQUIRE);
+  for (uint32_t i = 0; i < nbArray; i++) {
+    if (interflop_strcmp(vr_store->arrays[i].name, name) == 0) {
+      return &vr_store->arrays[i];
+    }
+  }
+  return NULL;
+}
+
+// array name of n elements, allocated at its first publication
+static verrou_store_array_t *_verrou_store_insert(const char *name,
+                                                  size_t n) {
+  int len = 0;
+  while (name[len] != '\0') {
+    if (++len == VERROU_STORE_NAME_SIZE) {
+      interflop_fprintf(stderr_stream, "Result name too long: %s\n", name);
+      return NULL;
+    }
+  }
+
+  _verrou_store_lock(&vr_store->lock);
+  verrou_store_array_t *array = _verrou_store_find(name);
+  if (array == NULL && vr_store->nb_array < VERROU_STORE_NB_ARRAY &&
+      n <= vr_store->capacity - vr_store->used) {
+    array = &vr_store->arrays[vr_store->nb_array];
+    for (int i = 0; i <= len; i++) {
+      array->name[i] = name[i];
+    }
+    array->size = n;
+    array->offset = vr_store->used;
+    vr_store->used += n;
+    __atomic_store_n(&vr_store->nb_array, vr_store->nb_array + 1,
+                     __ATOMIC_RELEASE);
+  }
+  _verrou_store_unlock(&vr_store->lock);
+
+  if (array == NULL) {
+    interflop_fprintf(stderr_stream, "Result store full for %s\n", name);
+  }
+  return array;
+}
+
+int verrou_store_publish(const char *name, const double *x, size_t n) {
+  if (vr_store == NULL) {
+    interflop_fprintf(stderr_stream, "No result store for %s\n", name);
+    return -1;
+  }
+  verrou_store_array_t *array = _verrou_store_find(name);
+  if (array == NULL) {
+    array = _verrou_store_insert(name, n);
+    if (array == NULL) {
+      return -1;
+    }
+  }
+  if (array->size != n) {
+    interflop_fprintf(stderr_stream,
+                      "Result %s published with %lu elements instead of "
+                      "%lu\n",
+                      name, (unsigned long)n, (unsigned long)array->size);
+    return -1;
+  }
+
+  // the lock is shared by all the samples: its critical section only
+  // touches the store and a private copy of x, so that a fault on x cannot
+  // leave it taken
+  double *copy = (double *)interflop_malloc(n * sizeof(double));
+  for (size_t i = 0; i < n; i++) {
+    copy[i] = x[i];
+  }
+
+  _verrou_store_lock(&array->lock);
+  verrou_store_element_t *elements =
+      _verrou_store_elements() + array->offset;
+  const uint64_t nbSample = array->nb_sample + 1;
+  for (size_t i = 0; i < n; i++) {
+    verrou_store_element_t *e = &elements[i];
+    const double delta = copy[i] - e->mean;
+    e->mean += delta / (double)nbSample;
+    e->m2 += delta * (copy[i] - e->mean);
+  }
+  array->nb_sample = nbSample;
+  _verrou_store_unlock(&array->lock);
+  interflop_free(copy);
+  return 0;
+}
+
+long verrou_store_read(const char *name, double *mean, double *variance,
+                       double *digits, size_t n) {
+  verrou_store_array_t *array =
+      vr_store == NULL ? NULL : _verrou_store_find(name);
+  if (array == NULL) {
+    return -1;
+  }
+  if (n > array->size) {
+    n = array->size;
+  }
+
+  // same private copy as publish, the outputs are written unlocked
+  verrou_store_element_t *copy = (verrou_store_element_t *)interflop_malloc(
+      n * sizeof(verrou_store_element_t));
+  _verrou_store_lock(&array->lock);
+  const verrou_store_element_t *elements =
+      _verrou_store_elements() + array->offset;
+  const uint64_t nbSample = array->nb_sample;
+  for (size_t i = 0; i < n; i++) {
+    copy[i] = elements[i];
+  }
+  _verrou_store_unlock(&array->lock);
+
+  for (size_t i = 0; i < n; i++) {
+    if (mean != NULL) {
+      mean[i] = copy[i].mean;
+    }
+    if (variance != NULL) {
+      variance[i] = nbSample < 2 ? 0. : copy[i].m2 / (double)(nbSample - 1);
+    }
+    if (digits != NULL) {
+      digits[i] = _verrou_store_digits(copy[i].mean, copy[i].m2, nbSample);
+    }
+  }
+  interflop_free(copy);
+  return (long)nbSample;
+}
+
+// * Thread contexts
+void *verrou_thread_context_new(void *context, enum vr_RoundingMode mode,
+                                uint64_t seed) {
+  verrou_context_t *ctx =
+      (verrou_context_t *)interflop_malloc(sizeof(verrou_context_t));
+  *ctx = *(verrou_context_t *)context;
+  ctx->default_rounding_mode = mode;
+  ctx->rounding_mode = mode;
+  ctx->seed = seed;
+  // the control block drives the process context only
+  ctx->control_file = NULL;
+  ctx->rand = (Vr_Rand *)interflop_calloc(1, sizeof(Vr_Rand));
+  ctx->rand->engine_ = ctx->random_engine;
+  vr_rand_setSeed(ctx->rand, seed);
+  return ctx;
+}
+
+void verrou_thread_context_free(void *context) {
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  if (vr_threadContext == ctx) {
+    vr_threadContext = NULL;
+  }
+  interflop_free(ctx->rand);
+  interflop_free(ctx);
+}
+
+struct interflop_backend_interface_t verrou_thread_backend(void *context) {
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  struct interflop_backend_interface_t backend =
+      get_static_backend<struct interflop_backend_interface_t>(ctx);
+  vr_maskOps(backend, vr_instrOps);
+  return backend;
+}
+
+verrou_value_backend_t verrou_thread_value_backend(void *context) {
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  verrou_value_backend_t backend =
+      get_static_backend<verrou_value_backend_t>(ctx);
+  vr_maskOps(backend, vr_instrOps);
+  return backend;
+}
+
+void verrou_bind_thread(void *context) {
+  vr_threadContext = (verrou_context_t *)context;
+}
+
+// * Control block
+static void _verrou_control_open(const char *path, verrou_context_t *ctx) {
+  const int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(verrou_control_t)) != 0) {
+    interflop_fprintf(stderr_stream, "Unable to open control file %s\n",
+                      path);
+    interflop_exit(42);
+  }
+  void *block = mmap(NULL, sizeof(verrou_control_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED) {
+    interflop_fprintf(stderr_stream, "Unable to map control file %s\n", path);
+    interflop_exit(42);
+  }
+
+  vr_control = (verrou_control_t *)block;
+  vr_control->sequence = 0;
+  vr_control->rounding_mode = ctx->default_rounding_mode;
+  vr_control->instrument = (ctx->rounding_mode == ctx->default_rounding_mode);
+  vr_control->seed = ctx->seed;
+  vr_control->prandom_p = -1.;
+  vr_control->applied_sequence = 0;
+  vr_control->nb_sync = 0;
+  for (int i = 0; i < VERROU_CONTROL_NB_OP; i++) {
+    vr_control->op_count[i] = 0;
+    vr_controlThread.opCount[i] = 0;
+  }
+  vr_controlSequence = 0;
+  vr_controlSeed = ctx->seed;
+  vr_control->version = VERROU_CONTROL_VERSION;
+  __atomic_store_n(&vr_control->magic, VERROU_CONTROL_MAGIC, __ATOMIC_RELEASE);
+}
+
+static void _verrou_control_close(void) {
+  if (vr_control != NULL) {
+    munmap(vr_control, sizeof(verrou_control_t));
+    vr_control = NULL;
+  }
+}
+
+// the counts of the thread since its last sync are merged into the block
+static void _verrou_control_flush(vr_controlThread_t *thread) {
+  for (int i = 0; i < VERROU_CONTROL_NB_OP; i++) {
+    if (thread->opCount[i] != 0) {
+      __atomic_fetch_add(&vr_control->op_count[i], thread->opCount[i],
+                         __ATOMIC_RELAXED);
+      thread->opCount[i] = 0;
+    }
+  }
+}
+
+// destructor of vr_controlKey: the ops of a thread since its last safe point
+// would otherwise be lost when it exits
+static void _verrou_control_thread_exit(void *thread) {
+  if (vr_control != NULL) {
+    _verrou_control_flush((vr_controlThread_t *)thread);
+  }
+}
+
+static void _verrou_control_key_create(void) {
+  pthread_key_create(&vr_controlKey, _verrou_control_thread_exit);
+}
+
+void verrou_control_sync(void *context) {
+  vr_controlThread.countdown = VR_CONTROL_PERIOD;
+  if (vr_control == NULL) {
+    return;
+  }
+  verrou_context_t *ctx = (verrou_context_t *)context;
+
+  if (__builtin_expect(!vr_controlThread.exitFlush, 0)) {
+    pthread_once(&vr_controlKeyOnce, _verrou_control_key_create);
+    pthread_setspecific(vr_controlKey, &vr_controlThread);
+    vr_controlThread.exitFlush = 1;
+  }
+  _verrou_control_flush(&vr_controlThread);
+  __atomic_fetch_add(&vr_control->nb_sync, 1, __ATOMIC_RELEASE);
+
+  // seqlock read: skip while the controller is writing or if it wrote
+  // during our read, the update is picked up at a later safe point
+  const uint64_t sequence =
+      __atomic_load_n(&vr_control->sequence, __ATOMIC_ACQUIRE);
+  if (sequence == vr_controlSequence || (sequence & 1) != 0) {
+    return;
+  }
+  const int32_t mode =
+      __atomic_load_n(&vr_control->rounding_mode, __ATOMIC_RELAXED);
+  const int32_t instrument =
+      __atomic_load_n(&vr_control->instrument, __ATOMIC_RELAXED);
+  const uint64_t seed = __atomic_load_n(&vr_control->seed, __ATOMIC_RELAXED);
+  double p;
+  __atomic_load(&vr_control->prandom_p, &p, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&vr_control->sequence, __ATOMIC_RELAXED) != sequence) {
+    return;
+  }
+
+  if (mode >= VR_NEAREST && mode < VR_FTZ) {
+    ctx->default_rounding_mode = (vr_RoundingMode)mode;
+  } else {
+    interflop_fprintf(stderr_stream, "Invalid control rounding mode (=%d)\n",
+                      mode);
+  }
+  ctx->rounding_mode = instrument ? ctx->default_rounding_mode : VR_NEAREST;
+  if (seed != vr_controlSeed) {
+    vr_controlSeed = seed;
+    _verrou_set_seed(seed);
+  }
+  if (p >= 0.) {
+    verrou_updatep_prandom_double(p);
+  }
+
+  vr_controlSequence = sequence;
+  __atomic_store_n(&vr_control->applied_sequence, sequence, __ATOMIC_RELEASE);
+}
+
+#define IFV_INLINE inline VR_MULTIARCH_KERNEL
 
 IFV_INLINE void INTERFLOP_VERROU_API(add_double)(double a, double b,
                                                  double *res, void *context) {
@@ -198,49 +1353,155 @@ IFV_INLINE void INTERFLOP_VERROU_API(sub_float)(float a, float b, float *res,
 IFV_INLINE void INTERFLOP_VERROU_API(mul_double)(double a, double b,
                                                  double *res, void *context) {
   typedef OpWithSelectedRoundingMode<MulOp<double>> Op;
-  Op::apply(Op::PackArgs(a, b), res, context);
+  Op::apply(Op::PackArgs(a, b), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(mul_float)(float a, float b, float *res,
+                                                void *context) {
+  typedef OpWithSelectedRoundingMode<MulOp<float>> Op;
+  Op::apply(Op::PackArgs(a, b), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(div_double)(double a, double b,
+                                                 double *res, void *context) {
+  typedef OpWithSelectedRoundingMode<DivOp<double>> Op;
+  Op::apply(Op::PackArgs(a, b), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(div_float)(float a, float b, float *res,
+                                                void *context) {
+  typedef OpWithSelectedRoundingMode<DivOp<float>> Op;
+  Op::apply(Op::PackArgs(a, b), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(cast_double_to_float)(double a, float *res,
+                                                           void *context) {
+  typedef OpWithSelectedRoundingMode<CastOp<double, float>> Op;
+  Op::apply(Op::PackArgs(a), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(fma_double)(double a, double b, double c,
+                                                 double *res, void *context) {
+  typedef OpWithSelectedRoundingMode<MAddOp<double>> Op;
+  Op::apply(Op::PackArgs(a, b, c), res, context);
+}
+
+IFV_INLINE void INTERFLOP_VERROU_API(fma_float)(float a, float b, float c,
+                                                float *res, void *context) {
+  typedef OpWithSelectedRoundingMode<MAddOp<float>> Op;
+  Op::apply(Op::PackArgs(a, b, c), res, context);
+}
+
+IFV_INLINE double INTERFLOP_VERROU_API(add_double_value)(double a, double b,
+                                                         void *context) {
+  typedef OpWithSelectedRoundingMode<AddOp<double>> Op;
+  double res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
+}
+
+IFV_INLINE float INTERFLOP_VERROU_API(add_float_value)(float a, float b,
+                                                       void *context) {
+  typedef OpWithSelectedRoundingMode<AddOp<float>> Op;
+  float res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
+}
+
+IFV_INLINE double INTERFLOP_VERROU_API(sub_double_value)(double a, double b,
+                                                         void *context) {
+  typedef OpWithSelectedRoundingMode<SubOp<double>> Op;
+  double res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
+}
+
+IFV_INLINE float INTERFLOP_VERROU_API(sub_float_value)(float a, float b,
+                                                       void *context) {
+  typedef OpWithSelectedRoundingMode<SubOp<float>> Op;
+  float res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
+}
+
+IFV_INLINE double INTERFLOP_VERROU_API(mul_double_value)(double a, double b,
+                                                         void *context) {
+  typedef OpWithSelectedRoundingMode<MulOp<double>> Op;
+  double res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(mul_float)(float a, float b, float *res,
-                                                void *context) {
+IFV_INLINE float INTERFLOP_VERROU_API(mul_float_value)(float a, float b,
+                                                       void *context) {
   typedef OpWithSelectedRoundingMode<MulOp<float>> Op;
-  Op::apply(Op::PackArgs(a, b), res, context);
+  float res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(div_double)(double a, double b,
-                                                 double *res, void *context) {
+IFV_INLINE double INTERFLOP_VERROU_API(div_double_value)(double a, double b,
+                                                         void *context) {
   typedef OpWithSelectedRoundingMode<DivOp<double>> Op;
-  Op::apply(Op::PackArgs(a, b), res, context);
+  double res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(div_float)(float a, float b, float *res,
-                                                void *context) {
+IFV_INLINE float INTERFLOP_VERROU_API(div_float_value)(float a, float b,
+                                                       void *context) {
   typedef OpWithSelectedRoundingMode<DivOp<float>> Op;
-  Op::apply(Op::PackArgs(a, b), res, context);
+  float res;
+  Op::apply(Op::PackArgs(a, b), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(cast_double_to_float)(double a, float *res,
-                                                           void *context) {
+IFV_INLINE float
+INTERFLOP_VERROU_API(cast_double_to_float_value)(double a, void *context) {
   typedef OpWithSelectedRoundingMode<CastOp<double, float>> Op;
-  Op::apply(Op::PackArgs(a), res, context);
+  float res;
+  Op::apply(Op::PackArgs(a), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(fma_double)(double a, double b, double c,
-                                                 double *res, void *context) {
+IFV_INLINE double INTERFLOP_VERROU_API(fma_double_value)(double a, double b,
+                                                         double c,
+                                                         void *context) {
   typedef OpWithSelectedRoundingMode<MAddOp<double>> Op;
-  Op::apply(Op::PackArgs(a, b, c), res, context);
+  double res;
+  Op::apply(Op::PackArgs(a, b, c), &res, context);
+  return res;
 }
 
-IFV_INLINE void INTERFLOP_VERROU_API(fma_float)(float a, float b, float c,
-                                                float *res, void *context) {
+IFV_INLINE float INTERFLOP_VERROU_API(fma_float_value)(float a, float b,
+                                                       float c, void *context) {
   typedef OpWithSelectedRoundingMode<MAddOp<float>> Op;
-  Op::apply(Op::PackArgs(a, b, c), res, context);
+  float res;
+  Op::apply(Op::PackArgs(a, b, c), &res, context);
+  return res;
 }
 
-typedef enum { KEY_ROUNDING_MODE, KEY_SEED } key_args;
+typedef enum {
+  KEY_ROUNDING_MODE,
+  KEY_SEED,
+  KEY_CONTROL_FILE,
+  KEY_NANINF,
+  KEY_INSTR_WINDOWS,
+  KEY_HARDWARE_ROUNDING,
+  KEY_INSTR_OPS,
+  KEY_RANDOM_ENGINE,
+  KEY_LIBM
+} key_args;
 
 static const char key_rounding_mode_str[] = "rounding-mode";
 static const char key_seed_str[] = "seed";
+static const char key_control_file_str[] = "control-file";
+static const char key_naninf_str[] = "naninf";
+static const char key_instr_windows_str[] = "instr-windows";
+static const char key_hardware_rounding_str[] = "hardware-rounding";
+static const char key_instr_ops_str[] = "instr-ops";
+static const char key_random_engine_str[] = "random-engine";
+static const char key_libm_str[] = "libm";
 
 static struct argp_option options[] = {
     {key_rounding_mode_str, KEY_ROUNDING_MODE, "ROUNDING MODE", 0,
@@ -249,6 +1510,41 @@ static struct argp_option options[] = {
      "average_comdet, farthest,float,native,ftz}",
      0},
     {key_seed_str, KEY_SEED, "SEED", 0, "fix the random generator seed", 0},
+    {key_control_file_str, KEY_CONTROL_FILE, "FILE", 0,
+     "memory-map FILE as a control block to change the rounding mode, seed "
+     "and p at runtime and to export op counters",
+     0},
+    {key_naninf_str, KEY_NANINF, "MODE", 0,
+     "NaN/Inf reporting among {handler, count, ignore}: call the interflop "
+     "handlers (dynamic backend only), count and report at finalize, or do "
+     "not check",
+     0},
+    {key_instr_windows_str, KEY_INSTR_WINDOWS, "WINDOWS", 0,
+     "perturb only the ops of each thread whose index is in WINDOWS: "
+     "BEGIN-END[,BEGIN-END...] (END excluded, may be omitted) or "
+     "LENGTH/PERIOD[:PHASE] for the PHASE-th window of LENGTH ops out of every "
+     "PERIOD ones; the other ops are native",
+     0},
+    {key_hardware_rounding_str, KEY_HARDWARE_ROUNDING, 0, 0,
+     "upward, downward and toward_zero are rounded by the hardware (AVX-512 "
+     "embedded rounding) instead of the software emulation, which is kept "
+     "on the processors without AVX-512",
+     0},
+    {key_instr_ops_str, KEY_INSTR_OPS, "OPS", 0,
+     "perturb only the ops in OPS: OP[_TYPE][,OP[_TYPE]...] with OP among "
+     "{add, sub, mul, div, fma, cast} and TYPE among {float, double} (both "
+     "when omitted, float only for the cast from double to float); the "
+     "other ops are native",
+     0},
+    {key_random_engine_str, KEY_RANDOM_ENGINE, "ENGINE", 0,
+     "random generator of the random, average and prandom modes among "
+     "{tinymt64, xoshiro256+, sfc64, wyrand}",
+     0},
+    {key_libm_str, KEY_LIBM, "MODE", 0,
+     "libm functions (verrou_libm_*) in the random modes among {accurate, "
+     "fast}: round the result evaluated in a wider type (default), or move "
+     "the inexact libm results one ulp up or down",
+     0},
     {0}};
 
 static error_t parse_opt(int key, char *arg, struct argp_state *state) {
@@ -315,12 +1611,238 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
     interflop_set_seed(ctx->seed, ctx);
     break;
 
+  case KEY_CONTROL_FILE:
+    ctx->control_file = arg;
+    break;
+
+  case KEY_NANINF:
+    if (interflop_strcasecmp("handler", arg) == 0) {
+      ctx->naninf_mode = VR_NANINF_HANDLER;
+    } else if (interflop_strcasecmp("count", arg) == 0) {
+      ctx->naninf_mode = VR_NANINF_COUNT;
+    } else if (interflop_strcasecmp("ignore", arg) == 0) {
+      ctx->naninf_mode = VR_NANINF_IGNORE;
+    } else {
+      interflop_fprintf(stderr_stream,
+                        "%s invalid value provided, must be one of: "
+                        " handler, count, ignore.\n",
+                        key_naninf_str);
+      interflop_exit(42);
+    }
+    break;
+
+  case KEY_INSTR_WINDOWS:
+    ctx->instr_windows = arg;
+    break;
+
+  case KEY_HARDWARE_ROUNDING:
+    ctx->hardware_rounding = 1;
+    break;
+
+  case KEY_INSTR_OPS:
+    ctx->instr_ops = arg;
+    break;
+
+  case KEY_RANDOM_ENGINE:
+    if (interflop_strcasecmp("tinymt64", arg) == 0) {
+      ctx->random_engine = VR_RAND_TINYMT64;
+    } else if (interflop_strcasecmp("xoshiro256+", arg) == 0) {
+      ctx->random_engine = VR_RAND_XOSHIRO256;
+    } else if (interflop_strcasecmp("sfc64", arg) == 0) {
+      ctx->random_engine = VR_RAND_SFC64;
+    } else if (interflop_strcasecmp("wyrand", arg) == 0) {
+      ctx->random_engine = VR_RAND_WYRAND;
+    } else {
+      interflop_fprintf(stderr_stream,
+                        "%s invalid value provided, must be one of: "
+                        " tinymt64, xoshiro256+, sfc64, wyrand.\n",
+                        key_random_engine_str);
+      interflop_exit(42);
+    }
+    break;
+
+  case KEY_LIBM:
+    if (interflop_strcasecmp("fast", arg) == 0) {
+      ctx->libm_mode = VR_LIBM_FAST;
+    } else if (interflop_strcasecmp("accurate", arg) == 0) {
+      ctx->libm_mode = VR_LIBM_ACCURATE;
+    } else {
+      interflop_fprintf(stderr_stream,
+                        "%s invalid value provided, must be one of: "
+                        " fast, accurate.\n",
+                        key_libm_str);
+      interflop_exit(42);
+    }
+    break;
+
   default:
     return ARGP_ERR_UNKNOWN;
   }
   return 0;
 }
 
+// * Instrumentation windows
+void vr_window_advance(void) {
+  const uint64_t begin = vr_windowThread.end;
+  uint64_t end = UINT64_MAX;
+  bool inside = false;
+  if (vr_windowLength != 0) {
+    const uint64_t window = begin / vr_windowLength;
+    const uint64_t skip =
+        (vr_windowPhase + vr_windowPeriod - window % vr_windowPeriod) %
+        vr_windowPeriod;
+    inside = (skip == 0);
+    end = (inside ? window + 1 : window + skip) * vr_windowLength;
+  } else {
+    for (int i = 0; i < vr_windowNbRange; i++) {
+      if (vr_windowEnd[i] > begin) {
+        inside = (vr_windowBegin[i] <= begin);
+        end = inside ? vr_windowEnd[i] : vr_windowBegin[i];
+        break;
+      }
+    }
+  }
+  vr_windowThread.inside = inside;
+  vr_windowThread.end = end;
+  vr_windowThread.countdown = end - begin;
+}
+
+static void _verrou_window_error(const char *spec) {
+  interflop_fprintf(stderr_stream,
+                    "%s invalid value provided (%s), must be "
+                    "BEGIN-END[,BEGIN-END...] with increasing ranges or "
+                    "LENGTH/PERIOD[:PHASE] with PHASE < PERIOD\n",
+                    key_instr_windows_str, spec);
+  interflop_exit(42);
+}
+
+static uint64_t _verrou_window_number(const char *spec, const char **str) {
+  int error = 0;
+  char *endptr;
+  const long res = interflop_strtol(*str, &endptr, &error);
+  if (error != 0 || endptr == *str || res < 0) {
+    _verrou_window_error(spec);
+  }
+  *str = endptr;
+  return res;
+}
+
+static void _verrou_window_parse(const char *spec) {
+  const char *str = spec;
+  uint64_t begin = _verrou_window_number(spec, &str);
+
+  if (*str == '/') {
+    str++;
+    vr_windowLength = begin;
+    vr_windowPeriod = _verrou_window_number(spec, &str);
+    vr_windowPhase = 0;
+    if (*str == ':') {
+      str++;
+      vr_windowPhase = _verrou_window_number(spec, &str);
+    }
+    if (*str != '\0' || vr_windowLength == 0 || vr_windowPeriod == 0 ||
+        vr_windowPhase >= vr_windowPeriod) {
+      _verrou_window_error(spec);
+    }
+    return;
+  }
+
+  vr_windowLength = 0;
+  vr_windowNbRange = 0;
+  for (;;) {
+    if (*str != '-' || vr_windowNbRange == VR_WINDOW_NB_RANGE) {
+      _verrou_window_error(spec);
+    }
+    str++;
+    uint64_t end = UINT64_MAX;
+    if (*str != ',' && *str != '\0') {
+      end = _verrou_window_number(spec, &str);
+    }
+    if (end <= begin ||
+        (vr_windowNbRange > 0 && begin < vr_windowEnd[vr_windowNbRange - 1])) {
+      _verrou_window_error(spec);
+    }
+    vr_windowBegin[vr_windowNbRange] = begin;
+    vr_windowEnd[vr_windowNbRange] = end;
+    vr_windowNbRange++;
+    if (*str == '\0') {
+      return;
+    }
+    if (*str != ',') {
+      _verrou_window_error(spec);
+    }
+    str++;
+    begin = _verrou_window_number(spec, &str);
+  }
+}
+
+// * Instrumented ops
+static void _verrou_instr_ops_error(const char *spec) {
+  interflop_fprintf(stderr_stream,
+                    "%s invalid value provided (%s), must be "
+                    "OP[_TYPE][,OP[_TYPE]...] with OP among add, sub, mul, "
+                    "div, fma, cast and TYPE among float, double (float "
+                    "only for cast)\n",
+                    key_instr_ops_str, spec);
+  interflop_exit(42);
+}
+
+static void _verrou_instr_ops_parse(const char *spec) {
+  // indexed by opHash and typeHash
+  static const char *opNames[nbOpHash] = {"add", "sub", "mul",
+                                          "div", "fma", "cast"};
+  static const char *typeNames[] = {"float", "double"};
+  const char *str = spec;
+  vr_instrOps = 0;
+  for (;;) {
+    char name[16];
+    size_t len = 0;
+    char *type = NULL;
+    while (str[len] != ',' && str[len] != '\0') {
+      if (len + 1 == sizeof(name)) {
+        _verrou_instr_ops_error(spec);
+      }
+      name[len] = str[len];
+      if (name[len] == '_' && type == NULL) {
+        name[len] = '\0';
+        type = name + len + 1;
+      }
+      len++;
+    }
+    name[len] = '\0';
+
+    uint32_t op = nbOpHash;
+    for (uint32_t i = 0; i < nbOpHash; i++) {
+      if (interflop_strcasecmp(opNames[i], name) == 0) {
+        op = i;
+      }
+    }
+    if (op == nbOpHash) {
+      _verrou_instr_ops_error(spec);
+    }
+    uint32_t ops = 0;
+    for (uint32_t i = floatHash; i <= doubleHash; i++) {
+      // the cast from double is hashed with its float result type
+      if (op == castHash && i != floatHash) {
+        continue;
+      }
+      if (type == NULL || interflop_strcasecmp(typeNames[i], type) == 0) {
+        ops |= 1U << (op * nbTypeHash + i);
+      }
+    }
+    if (ops == 0) {
+      _verrou_instr_ops_error(spec);
+    }
+    vr_instrOps |= ops;
+
+    str += len;
+    if (*str == '\0') {
+      return;
+    }
+    str++;
+  }
+}
+
 #define CHECK_IMPL(name)                                                       \
   if (interflop_##name == Null) {                                              \
     interflop_panic("Interflop backend error: " #name " not implemented\n");   \
@@ -342,12 +1864,22 @@ void _verrou_alloc_context(void **context) {
   *context = (verrou_context_t *)interflop_malloc(sizeof(verrou_context_t));
 }
 
-void _verrou_init_context(verrou_context_t *ctx) {
+static void _verrou_init_context(verrou_context_t *ctx) {
   ctx->default_rounding_mode = VR_NEAREST;
   ctx->rounding_mode = VR_NEAREST; // default value
+  ctx->naninf_mode = VR_NANINF_HANDLER;
   ctx->seed = (unsigned int)-1;
+  ctx->control_file = NULL;
+  ctx->instr_windows = NULL;
+  ctx->hardware_rounding = 0;
+  ctx->instr_ops = NULL;
+  ctx->random_engine = VR_RAND_ENGINE_DEFAULT;
+  ctx->libm_mode = VR_LIBM_ACCURATE;
+  ctx->rand = &vr_rand;
 }
 
+void verrou_conf_init(verrou_conf_t *conf) { _verrou_init_context(conf); }
+
 void INTERFLOP_VERROU_API(pre_init)(File *stream, interflop_panic_t panic,
                                     void **context) {
   stderr_stream = stream;
@@ -375,7 +1907,7 @@ void INTERFLOP_VERROU_API(CLI)(int argc, char **argv, void *context) {
 }
 
 static void _interflop_usercall_inexact(void *context, va_list ap) {
-  verrou_context_t *ctx = (verrou_context_t *)context;
+  Vr_Rand *rand = vr_contextRand(context);
   typedef std::underlying_type<enum FTYPES>::type ftypes_t;
   float xf = 0;
   double xd = 0;
@@ -386,12 +1918,12 @@ static void _interflop_usercall_inexact(void *context, va_list ap) {
   switch (ftype) {
   case FFLOAT:
     xf = *((float *)value);
-    xf = vr_rand_bool(&vr_rand) ? nextAfter<float>(xf) : nextPrev<float>(xf);
+    xf = vr_rand_bool(rand) ? nextAfter<float>(xf) : nextPrev<float>(xf);
     *((float *)value) = xf;
     break;
   case FDOUBLE:
     xd = *((double *)value);
-    xd = vr_rand_bool(&vr_rand) ? nextAfter<double>(xd) : nextPrev<double>(xd);
+    xd = vr_rand_bool(rand) ? nextAfter<double>(xd) : nextPrev<double>(xd);
     *((double *)value) = xd;
     break;
   default:
@@ -402,30 +1934,664 @@ static void _interflop_usercall_inexact(void *context, va_list ap) {
   }
 }
 
+/*
+ * same perturbation as _interflop_usercall_inexact for each element, one
+ * random bit per element taken from a bulk generated block of words
+ */
+extern "C++" template <class REALTYPE, class UINTTYPE>
+inline void _verrou_inexact_array(REALTYPE *x, size_t n, Vr_Rand *rand) {
+  constexpr size_t nbWords = 16;
+  constexpr size_t blockSize = 64 * nbWords;
+  const REALTYPE negDenormMin = -std::numeric_limits<REALTYPE>::denorm_min();
+  UINTTYPE negDenormMinU;
+  __builtin_memcpy(&negDenormMinU, &negDenormMin, sizeof(UINTTYPE));
+  uint64_t words[nbWords];
+
+  for (size_t start = 0; start < n; start += blockSize) {
+    const size_t size = std::min(blockSize, n - start);
+    vr_rand_fill(rand, words, (size + 63) / 64);
+    REALTYPE *block = x + start;
+    for (size_t i = 0; i < size; i++) {
+      const REALTYPE v = block[i];
+      UINTTYPE u;
+      __builtin_memcpy(&u, &v, sizeof(UINTTYPE));
+      // branchless nextAfter<REALTYPE> and nextPrev<REALTYPE>
+      const UINTTYPE after = (v >= 0) ? u + 1 : u - 1;
+      const UINTTYPE prev =
+          (v > 0) ? u - 1 : ((v != 0) ? u + 1 : negDenormMinU);
+      const bool up = (words[i / 64] >> (i % 64)) & 1;
+      const UINTTYPE res = up ? after : prev;
+      __builtin_memcpy(&block[i], &res, sizeof(UINTTYPE));
+    }
+  }
+}
+
+VR_MULTIARCH_KERNEL void verrou_inexact_array_double(double *x, size_t n) {
+  _verrou_inexact_array<double, uint64_t>(x, n, vr_boundRand());
+}
+
+VR_MULTIARCH_KERNEL void verrou_inexact_array_float(float *x, size_t n) {
+  _verrou_inexact_array<float, uint32_t>(x, n, vr_boundRand());
+}
+
+// * Reductions
+
+extern "C++" template <class OP>
+inline void _verrou_reduction_count(size_t nb) {
+  if (vr_control != NULL) {
+    vr_control_count(OP::getHash(), nb);
+  }
+}
+
+VR_MULTIARCH_KERNEL double verrou_sum_double(const double *x, size_t n,
+                                             void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<AddOp<double> >(n);
+  return vr_reduction_dispatch(vr_sumKernel<double>(x, n, context), context);
+}
+
+VR_MULTIARCH_KERNEL float verrou_sum_float(const float *x, size_t n,
+                                           void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<AddOp<float> >(n);
+  return vr_reduction_dispatch(vr_sumKernel<float>(x, n, context), context);
+}
+
+VR_MULTIARCH_KERNEL double verrou_dot_double(const double *x, const double *y,
+                                             size_t n, void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<MAddOp<double> >(n);
+  return vr_reduction_dispatch(vr_dotKernel<double>(x, y, n, context),
+                               context);
+}
+
+VR_MULTIARCH_KERNEL float verrou_dot_float(const float *x, const float *y,
+                                           size_t n, void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<MAddOp<float> >(n);
+  return vr_reduction_dispatch(vr_dotKernel<float>(x, y, n, context), context);
+}
+
+// sqrt is not an instrumented op: only the sum of squares is perturbed
+// (inlined as -fno-math-errno is set)
+double verrou_norm2_double(const double *x, size_t n, void *context) {
+  return __builtin_sqrt(verrou_dot_double(x, x, n, context));
+}
+
+float verrou_norm2_float(const float *x, size_t n, void *context) {
+  return __builtin_sqrtf(verrou_dot_float(x, x, n, context));
+}
+
+VR_MULTIARCH_KERNEL void verrou_axpy_double(double a, const double *x,
+                                            double *y, size_t n,
+                                            void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<MAddOp<double> >(n);
+  vr_reduction_dispatch(vr_axpyKernel<double>(a, x, y, n, context), context);
+}
+
+VR_MULTIARCH_KERNEL void verrou_axpy_float(float a, const float *x, float *y,
+                                           size_t n, void *context) {
+  verrou_control_sync(context);
+  _verrou_reduction_count<MAddOp<float> >(n);
+  vr_reduction_dispatch(vr_axpyKernel<float>(a, x, y, n, context), context);
+}
+
+// * Shadow values
+static verrou_shadow_t _verrou_shadow_pair(double value,
+                                           const vr_doubleDouble &shadow) {
+  verrou_shadow_t res;
+  res.value = value;
+  res.hi = shadow.hi;
+  res.lo = shadow.lo;
+  return res;
+}
+
+static vr_doubleDouble _verrou_shadow_dd(const verrou_shadow_t &x) {
+  return vr_doubleDouble(x.hi, x.lo);
+}
+
+verrou_shadow_t verrou_shadow(double x) {
+  return _verrou_shadow_pair(x, vr_doubleDouble(x));
+}
+
+verrou_shadow_t verrou_shadow_add(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context) {
+  double value;
+  INTERFLOP_VERROU_API(add_double)(a.value, b.value, &value, context);
+  return _verrou_shadow_pair(
+      value, vr_doubleDouble::add(_verrou_shadow_dd(a), _verrou_shadow_dd(b)));
+}
+
+verrou_shadow_t verrou_shadow_sub(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context) {
+  double value;
+  INTERFLOP_VERROU_API(sub_double)(a.value, b.value, &value, context);
+  return _verrou_shadow_pair(
+      value, vr_doubleDouble::add(_verrou_shadow_dd(a),
+                                  vr_doubleDouble::neg(_verrou_shadow_dd(b))));
+}
+
+verrou_shadow_t verrou_shadow_mul(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context) {
+  double value;
+  INTERFLOP_VERROU_API(mul_double)(a.value, b.value, &value, context);
+  return _verrou_shadow_pair(
+      value, vr_doubleDouble::mul(_verrou_shadow_dd(a), _verrou_shadow_dd(b)));
+}
+
+verrou_shadow_t verrou_shadow_div(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context) {
+  double value;
+  INTERFLOP_VERROU_API(div_double)(a.value, b.value, &value, context);
+  return _verrou_shadow_pair(
+      value, vr_doubleDouble::div(_verrou_shadow_dd(a), _verrou_shadow_dd(b)));
+}
+
+verrou_shadow_t verrou_shadow_fma(verrou_shadow_t a, verrou_shadow_t b,
+                                  verrou_shadow_t c, void *context) {
+  double value;
+  INTERFLOP_VERROU_API(fma_double)(a.value, b.value, c.value, &value,
+                                   context);
+  return _verrou_shadow_pair(
+      value, vr_doubleDouble::add(vr_doubleDouble::mul(_verrou_shadow_dd(a),
+                                                       _verrou_shadow_dd(b)),
+                                  _verrou_shadow_dd(c)));
+}
+
+static vr_doubleDouble _verrou_shadow_dot(const double *x, const double *y,
+                                          size_t n) {
+  vr_doubleDouble acc;
+  for (size_t i = 0; i < n; i++) {
+    double p, e;
+    MulOp<double>::twoProd(x[i], y[i], p, e);
+    acc = vr_doubleDouble::add(acc, vr_doubleDouble(p, e));
+  }
+  return acc;
+}
+
+verrou_shadow_t verrou_shadow_sum(const double *x, size_t n, void *context) {
+  vr_doubleDouble acc;
+  for (size_t i = 0; i < n; i++) {
+    acc = vr_doubleDouble::add(acc, vr_doubleDouble(x[i]));
+  }
+  return _verrou_shadow_pair(verrou_sum_double(x, n, context), acc);
+}
+
+verrou_shadow_t verrou_shadow_dot(const double *x, const double *y, size_t n,
+                                  void *context) {
+  return _verrou_shadow_pair(verrou_dot_double(x, y, n, context),
+                             _verrou_shadow_dot(x, y, n));
+}
+
+verrou_shadow_t verrou_shadow_norm2(const double *x, size_t n, void *context) {
+  return _verrou_shadow_pair(
+      verrou_norm2_double(x, n, context),
+      vr_doubleDouble::sqrt(_verrou_shadow_dot(x, x, n)));
+}
+
+double verrou_shadow_error(verrou_shadow_t x) {
+  return _verrou_shadow_dd(x).relativeError(x.value);
+}
+
+// checkpoint name, inserted if needed (NULL if the table is full)
+static vr_shadowCheckpoint_t *_verrou_shadow_find(const char *name) {
+  for (int i = 0; i < vr_shadowNbCheckpoint; i++) {
+    if (interflop_strcmp(vr_shadowCheckpoints[i].name, name) == 0) {
+      return &vr_shadowCheckpoints[i];
+    }
+  }
+  if (vr_shadowNbCheckpoint == VERROU_SHADOW_NB_CHECKPOINT) {
+    return NULL;
+  }
+  vr_shadowCheckpoint_t *checkpoint =
+      &vr_shadowCheckpoints[vr_shadowNbCheckpoint++];
+  // the length is checked by the caller
+  for (int i = 0; i == 0 || name[i - 1] != '\0'; i++) {
+    checkpoint->name[i] = name[i];
+  }
+  return checkpoint;
+}
+
+double verrou_shadow_checkpoint(const char *name, const verrou_shadow_t *x,
+                                size_t n) {
+  double maxError = 0.;
+  for (size_t i = 0; i < n; i++) {
+    const double error = verrou_shadow_error(x[i]);
+    // NaN as soon as one value is NaN
+    if (!(error <= maxError)) {
+      maxError = error;
+    }
+  }
+
+  int len = 0;
+  while (name[len] != '\0') {
+    if (++len == VERROU_SHADOW_NAME_SIZE) {
+      interflop_fprintf(stderr_stream, "Checkpoint name too long: %s\n",
+                        name);
+      return maxError;
+    }
+  }
+
+  _verrou_store_lock(&vr_shadowLock);
+  vr_shadowCheckpoint_t *checkpoint = _verrou_shadow_find(name);
+  if (checkpoint != NULL) {
+    checkpoint->nbCall++;
+    checkpoint->nbValue += n;
+    if (!(maxError <= checkpoint->maxError)) {
+      checkpoint->maxError = maxError;
+    }
+    checkpoint->sumError += maxError;
+  }
+  _verrou_store_unlock(&vr_shadowLock);
+
+  if (checkpoint == NULL) {
+    interflop_fprintf(stderr_stream, "Too many shadow checkpoints for %s\n",
+                      name);
+  }
+  return maxError;
+}
+
+void verrou_print_shadow_checkpoints(void) {
+  if (vr_shadowNbCheckpoint == 0) {
+    return;
+  }
+  interflop_fprintf(stderr_stream, "VERROU shadow checkpoints (%d):\n",
+                    vr_shadowNbCheckpoint);
+  for (int i = 0; i < vr_shadowNbCheckpoint; i++) {
+    const vr_shadowCheckpoint_t *checkpoint = &vr_shadowCheckpoints[i];
+    const double maxError = checkpoint->maxError;
+    double digits = VR_STORE_MAX_DIGITS;
+    if (!(maxError <= 0.)) {
+      digits = -_verrou_log10(maxError);
+      digits = digits < VR_STORE_MAX_DIGITS ? digits : VR_STORE_MAX_DIGITS;
+      digits = digits > 0. ? digits : 0.; // also NaN
+    }
+    interflop_fprintf(stderr_stream,
+                      "  %s: %lu calls, %lu values, max relative error %.3e "
+                      "(mean %.3e), %.2f significant digits\n",
+                      checkpoint->name, checkpoint->nbCall,
+                      checkpoint->nbValue, maxError,
+                      checkpoint->sumError / (double)checkpoint->nbCall,
+                      digits);
+  }
+}
+
+// * libm
+#ifdef VERROU_LIBM
+static void _verrou_libm_resolve(void) {
+  void *handle = dlopen(LIBM_SO, RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    interflop_fprintf(stderr_stream, "Unable to open %s\n", LIBM_SO);
+    interflop_exit(42);
+  }
+#define VR_LIBM_RESOLVE(SYMBOL)                                                \
+  vr_libmNative.SYMBOL =                                                       \
+      (decltype(vr_libmNative.SYMBOL))dlsym(handle, #SYMBOL);                  \
+  if (vr_libmNative.SYMBOL == NULL) {                                          \
+    interflop_fprintf(stderr_stream, "Unable to find %s in %s\n", #SYMBOL,     \
+                      LIBM_SO);                                                \
+    interflop_exit(42);                                                        \
+  }
+#define VR_LIBM_RESOLVE_ALL(NAME)                                              \
+  VR_LIBM_RESOLVE(NAME) VR_LIBM_RESOLVE(NAME##f) VR_LIBM_RESOLVE(NAME##l)
+  VERROU_LIBM_FUNCTIONS_1(VR_LIBM_RESOLVE_ALL)
+  VERROU_LIBM_FUNCTIONS_2(VR_LIBM_RESOLVE_ALL)
+#undef VR_LIBM_RESOLVE_ALL
+#undef VR_LIBM_RESOLVE
+  __atomic_store_n(&vr_libmNativeReady, true, __ATOMIC_RELEASE);
+}
+
+void vr_libm_resolve(void) {
+  pthread_once(&vr_libmNativeOnce, _verrou_libm_resolve);
+}
+
+/*
+ * The fast mode (--libm=fast) of the random modes: the libm result moves one
+ * ulp up or down, as with verrou_inexact, without evaluating the function in
+ * the wider type. Zero, the infinities, NaN and the exact results (see
+ * LibmOp::mayBeExact) are kept. The decision is a random bit (random) or a
+ * hash of the arguments, the function and the seed (random_det,
+ * random_comdet: none of the functions is commutative).
+ */
+static inline bool _verrou_libm_fast(const verrou_context_t *ctx) {
+  return ctx->libm_mode == VR_LIBM_FAST &&
+         (ctx->rounding_mode == VR_RANDOM ||
+          ctx->rounding_mode == VR_RANDOM_DET ||
+          ctx->rounding_mode == VR_RANDOM_COMDET);
+}
+
+extern "C++" inline uint64_t _verrou_libm_bits(double x) {
+  uint64_t u;
+  __builtin_memcpy(&u, &x, sizeof(u));
+  return u;
+}
+
+extern "C++" inline uint64_t _verrou_libm_bits(float x) {
+  uint32_t u;
+  __builtin_memcpy(&u, &x, sizeof(u));
+  return u;
+}
+
+// key of the det decisions of OP
+extern "C++" template <class OP>
+inline uint64_t _verrou_libm_detKey(const Vr_Rand *rand) {
+  return rand->hashKey_ ^ (OP::getHash() * 0x9E3779B97F4A7C15ULL);
+}
+
+extern "C++" template <class REALTYPE>
+inline bool _verrou_libm_detUp(uint64_t key,
+                               const vr_packArg<REALTYPE, 1> &p) {
+  return vr_rand_mix64(key ^ _verrou_libm_bits(p.arg1)) & 1;
+}
+
+extern "C++" template <class REALTYPE>
+inline bool _verrou_libm_detUp(uint64_t key,
+                               const vr_packArg<REALTYPE, 2> &p) {
+  return vr_rand_mix64(key ^ _verrou_libm_bits(p.arg1) ^
+                       (_verrou_libm_bits(p.arg2) * 0xD6E8FEB86659FD93ULL)) &
+         1;
+}
+
+// the wider type evaluated for the results which may be exact only
+extern "C++" template <class OP>
+inline bool _verrou_libm_exact(const typename OP::PackArgs &p,
+                               const typename OP::RealType &x) {
+  return __builtin_expect(OP::mayBeExact(p, x), 0) && OP::error(p, x) == 0;
+}
+
+// branchless: the successor (up) or the predecessor of *v, in place, unless
+// exact
+extern "C++" template <class REALTYPE, class UINTTYPE>
+inline void _verrou_libm_move(REALTYPE *v, UINTTYPE up, bool exact) {
+  const REALTYPE inf = std::numeric_limits<REALTYPE>::infinity();
+  const REALTYPE x = *v;
+  UINTTYPE u, infU;
+  __builtin_memcpy(&u, &x, sizeof(UINTTYPE));
+  __builtin_memcpy(&infU, &inf, sizeof(UINTTYPE));
+  const bool keep = exact | (x == 0) | ((u & infU) == infU);
+  const UINTTYPE step = (up == (x > 0)) ? 1 : (UINTTYPE)-1;
+  const UINTTYPE res = u + (keep ? 0 : step);
+  __builtin_memcpy(v, &res, sizeof(UINTTYPE));
+}
+
+// the rounding mode is applied directly (applySeq): the libm ops are neither
+// counted nor checked for NaN/Inf, and the instrumentation windows and
+// --instr-ops do not apply to them
+extern "C++" template <class OP, class UINTTYPE>
+inline typename OP::RealType _verrou_libm(const typename OP::PackArgs &p) {
+  void *context = vr_boundContext(vr_libmContext);
+  if (context == NULL) {
+    return OP::nearestOp(p);
+  }
+  const verrou_context_t *ctx = (const verrou_context_t *)context;
+  if (_verrou_libm_fast(ctx)) {
+    Vr_Rand *rand = vr_contextRand(context);
+    const UINTTYPE up =
+        (ctx->rounding_mode == VR_RANDOM)
+            ? vr_rand_bool(rand)
+            : _verrou_libm_detUp(_verrou_libm_detKey<OP>(rand), p);
+    typename OP::RealType res = OP::nearestOp(p);
+    _verrou_libm_move(&res, up, _verrou_libm_exact<OP>(p, res));
+    return res;
+  }
+  return OpWithSelectedRoundingMode<OP>::applySeq(p, context);
+}
+
+// arguments of the element i of the array variants
+extern "C++" template <class REALTYPE> struct vr_libmArgs1 {
+  const REALTYPE *x;
+  inline vr_packArg<REALTYPE, 1> pack(size_t i) const {
+    return vr_packArg<REALTYPE, 1>(x[i]);
+  }
+};
+
+extern "C++" template <class REALTYPE> struct vr_libmArgs2 {
+  const REALTYPE *x;
+  const REALTYPE *y;
+  inline vr_packArg<REALTYPE, 2> pack(size_t i) const {
+    return vr_packArg<REALTYPE, 2>(x[i], y[i]);
+  }
+};
+
+/*
+ * In the fast mode, by blocks: the decisions are taken before the libm loop
+ * overwrites the arguments, and the loops drawing them and moving the results
+ * are vectorizable.
+ */
+extern "C++" template <class OP, class UINTTYPE, class ARGS>
+inline void _verrou_libm_array(typename OP::RealType *x, size_t n,
+                               const ARGS &args) {
+  void *context = vr_boundContext(vr_libmContext);
+  if (context == NULL) {
+    for (size_t i = 0; i < n; i++) {
+      x[i] = OP::nearestOp(args.pack(i));
+    }
+    return;
+  }
+  const verrou_context_t *ctx = (const verrou_context_t *)context;
+  if (!_verrou_libm_fast(ctx)) {
+    for (size_t i = 0; i < n; i++) {
+      x[i] = OpWithSelectedRoundingMode<OP>::applySeq(args.pack(i), context);
+    }
+    return;
+  }
+
+  constexpr size_t nbWords = 16;
+  constexpr size_t blockSize = 64 * nbWords;
+  Vr_Rand *rand = vr_contextRand(context);
+  const uint64_t key = _verrou_libm_detKey<OP>(rand);
+  uint64_t words[nbWords];
+  UINTTYPE up[blockSize];
+  bool exact[blockSize];
+
+  for (size_t start = 0; start < n; start += blockSize) {
+    const size_t size = std::min(blockSize, n - start);
+    if (ctx->rounding_mode == VR_RANDOM) {
+      vr_rand_fill(rand, words, (size + 63) / 64);
+      for (size_t i = 0; i < size; i++) {
+        up[i] = (words[i / 64] >> (i % 64)) & 1;
+      }
+    } else {
+      for (size_t i = 0; i < size; i++) {
+        up[i] = _verrou_libm_detUp(key, args.pack(start + i));
+      }
+    }
+    typename OP::RealType *block = x + start;
+    for (size_t i = 0; i < size; i++) {
+      // the pack refers to x: checked before the result overwrites it
+      const typename OP::PackArgs p = args.pack(start + i);
+      const typename OP::RealType res = OP::nearestOp(p);
+      exact[i] = _verrou_libm_exact<OP>(p, res);
+      block[i] = res;
+    }
+    for (size_t i = 0; i < size; i++) {
+      _verrou_libm_move(&block[i], up[i], exact[i]);
+    }
+  }
+}
+
+#define VR_LIBM_DEFINE_1(NAME)                                                 \
+  double verrou_libm_##NAME(double x) {                                        \
+    typedef LibmOp<vr_libm_##NAME, double, 1> Op;                              \
+    return _verrou_libm<Op, uint64_t>(Op::PackArgs(x));                        \
+  }                                                                            \
+  float verrou_libm_##NAME##f(float x) {                                       \
+    typedef LibmOp<vr_libm_##NAME, float, 1> Op;                               \
+    return _verrou_libm<Op, uint32_t>(Op::PackArgs(x));                        \
+  }                                                                            \
+  void verrou_libm_##NAME##_array(double *x, size_t n) {                       \
+    const vr_libmArgs1<double> args = {x};                                     \
+    _verrou_libm_array<LibmOp<vr_libm_##NAME, double, 1>, uint64_t>(x, n,      \
+                                                                    args);     \
+  }                                                                            \
+  void verrou_libm_##NAME##f_array(float *x, size_t n) {                       \
+    const vr_libmArgs1<float> args = {x};                                      \
+    _verrou_libm_array<LibmOp<vr_libm_##NAME, float, 1>, uint32_t>(x, n,       \
+                                                                   args);      \
+  }
+#define VR_LIBM_DEFINE_2(NAME)                                                 \
+  double verrou_libm_##NAME(double x, double y) {                              \
+    typedef LibmOp<vr_libm_##NAME, double, 2> Op;                              \
+    return _verrou_libm<Op, uint64_t>(Op::PackArgs(x, y));                     \
+  }                                                                            \
+  float verrou_libm_##NAME##f(float x, float y) {                              \
+    typedef LibmOp<vr_libm_##NAME, float, 2> Op;                               \
+    return _verrou_libm<Op, uint32_t>(Op::PackArgs(x, y));                     \
+  }                                                                            \
+  void verrou_libm_##NAME##_array(double *x, const double *y, size_t n) {      \
+    const vr_libmArgs2<double> args = {x, y};                                  \
+    _verrou_libm_array<LibmOp<vr_libm_##NAME, double, 2>, uint64_t>(x, n,      \
+                                                                    args);     \
+  }                                                                            \
+  void verrou_libm_##NAME##f_array(float *x, const float *y, size_t n) {       \
+    const vr_libmArgs2<float> args = {x, y};                                   \
+    _verrou_libm_array<LibmOp<vr_libm_##NAME, float, 2>, uint32_t>(x, n,       \
+                                                                   args);      \
+  }
+VERROU_LIBM_FUNCTIONS_1(VR_LIBM_DEFINE_1)
+VERROU_LIBM_FUNCTIONS_2(VR_LIBM_DEFINE_2)
+
+#define VR_LIBM_ENTRY(NAME) verrou_libm_##NAME, verrou_libm_##NAME##f,
+static const verrou_libm_backend_t vr_libmBackend = {
+    VERROU_LIBM_FUNCTIONS_1(VR_LIBM_ENTRY)
+        VERROU_LIBM_FUNCTIONS_2(VR_LIBM_ENTRY)};
+
+// gives the libm entry points to libinterflop_verrou_libm, when preloaded
+static void _verrou_libm_register(void *context) {
+  vr_libmContext = context;
+  typedef void (*vr_libmRegister_t)(const verrou_libm_backend_t *);
+  const vr_libmRegister_t libmRegister =
+      (vr_libmRegister_t)dlsym(RTLD_DEFAULT, "verrou_libm_register");
+  if (libmRegister != NULL) {
+    libmRegister(&vr_libmBackend);
+  }
+}
+#endif
+
+static void
+_interflop_usercall_inexact_array(__attribute__((unused)) void *context,
+                                  va_list ap) {
+  typedef std::underlying_type<enum FTYPES>::type ftypes_t;
+  ftypes_t ftype;
+  void *array = NULL;
+  size_t n = 0;
+  ftype = va_arg(ap, ftypes_t);
+  array = va_arg(ap, void *);
+  n = va_arg(ap, size_t);
+  switch (ftype) {
+  case FFLOAT:
+    verrou_inexact_array_float((float *)array, n);
+    break;
+  case FDOUBLE:
+    verrou_inexact_array_double((double *)array, n);
+    break;
+  default:
+    interflop_fprintf(
+        stderr_stream,
+        "Uknown type passed to _interflop_usercall_inexact_array function");
+    break;
+  }
+}
+
 void INTERFLOP_VERROU_API(user_call)(void *context, interflop_call_id id,
                                      va_list ap) {
-  switch (id) {
+  verrou_control_sync(context);
+  switch ((int)id) {
   case INTERFLOP_INEXACT_ID:
     _interflop_usercall_inexact(context, ap);
     break;
+  case VR_INEXACT_ARRAY_ID:
+    _interflop_usercall_inexact_array(context, ap);
+    break;
   default:
     interflop_fprintf(stderr_stream, "Unknown interflop_call id (=%d)", id);
     break;
   }
 }
 
-void INTERFLOP_VERROU_API(finalize)(void *context) {}
+void INTERFLOP_VERROU_API(finalize)(void *context) {
+  verrou_control_sync(context);
+  _verrou_control_close();
+  verrou_store_close();
+  _verrou_report_naninf();
+  _verrou_report_det_hash_cache();
+  verrou_print_profiling_events();
+  verrou_print_profiling_sites();
+  verrou_print_precision_advice();
+  verrou_print_shadow_checkpoints();
+}
 
 struct interflop_backend_interface_t INTERFLOP_VERROU_API(init)(void *context) {
   verrou_context_t *ctx = (verrou_context_t *)context;
 
+#ifdef VR_RUNTIME_FMA
+  // op kernels are resolved by ifunc, the fma used to compute rounding
+  // errors is selected here
+  __builtin_cpu_init();
+  vr_hardwareFma = __builtin_cpu_supports("fma");
+#endif
+
+  if (ctx->instr_windows != NULL) {
+    _verrou_window_parse(ctx->instr_windows);
+  }
+  vr_instrOps = VR_INSTR_OPS_ALL;
+  if (ctx->instr_ops != NULL) {
+    _verrou_instr_ops_parse(ctx->instr_ops);
+  }
+#ifdef VR_HARDWARE_ROUNDING
+  __builtin_cpu_init();
+  vr_hardwareEmbeddedRounding = __builtin_cpu_supports("avx512f");
+  if (ctx->hardware_rounding && !vr_hardwareEmbeddedRounding) {
+    interflop_fprintf(stderr_stream,
+                      "%s needs AVX-512, the directed modes are emulated\n",
+                      key_hardware_rounding_str);
+  }
+#else
+  if (ctx->hardware_rounding) {
+    interflop_fprintf(stderr_stream,
+                      "%s is not available on this architecture, the "
+                      "directed modes are emulated\n",
+                      key_hardware_rounding_str);
+  }
+#endif
   struct interflop_backend_interface_t interflop_verrou_backend =
-      get_static_backend(ctx);
+      get_static_backend<struct interflop_backend_interface_t>(ctx);
 
+  vr_rand_setEngine(&vr_rand, ctx->random_engine);
   interflop_set_seed(ctx->seed, ctx);
+
+  if (ctx->control_file != NULL) {
+    // the rounding mode may change at any safe point: the static backends
+    // cannot be used
+    _verrou_control_open(ctx->control_file, ctx);
+    interflop_verrou_backend = dynamic_backend;
+    if (ctx->instr_windows != NULL) {
+      interflop_fprintf(stderr_stream,
+                        "%s is ignored with %s, use the instrument field of "
+                        "the control block\n",
+                        key_instr_windows_str, key_control_file_str);
+    }
+  }
+  vr_maskOps(interflop_verrou_backend, vr_instrOps);
+#ifdef VERROU_LIBM
+  _verrou_libm_register(context);
+#endif
   return interflop_verrou_backend;
 }
 
+verrou_value_backend_t INTERFLOP_VERROU_API(value_backend)(void *context) {
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  vr_valueContext = context;
+  // same selection as init
+  verrou_value_backend_t backend = dynamic_value_backend;
+  if (ctx->control_file == NULL) {
+    backend = get_static_backend<verrou_value_backend_t>(ctx);
+  }
+  vr_maskOps(backend, vr_instrOps);
+  return backend;
+}
+
 struct interflop_backend_interface_t interflop_init(void *context)
     __attribute__((weak, alias("interflop_verrou_init")));
 
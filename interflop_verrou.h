@@ -38,6 +38,8 @@ extern "C" {
 #endif
 #define INTERFLOP_VERROU_API(FCT) interflop_verrou_##FCT
 
+#include <stdint.h>
+
 #include "interflop-stdlib/interflop.h"
 #include "interflop-stdlib/interflop_stdlib.h"
 
@@ -61,21 +63,67 @@ enum vr_RoundingMode {
   VR_FTZ
 };
 
+enum vr_NanInfMode {
+  VR_NANINF_HANDLER, /* interflop_nanHandler/infHandler on each occurrence,
+                        no check in the static backends */
+  VR_NANINF_COUNT,   /* counted per op and type with the first occurrences,
+                        reported at finalize */
+  VR_NANINF_IGNORE   /* no check */
+};
+
+/* generator of the random, average and prandom modes */
+enum vr_RandEngine {
+  VR_RAND_TINYMT64,
+  VR_RAND_XOSHIRO256, /* xoshiro256+ */
+  VR_RAND_SFC64,
+  VR_RAND_WYRAND
+};
+
+/* evaluation of the libm functions in the random modes (random, random_det,
+   random_comdet), the other modes are always accurate */
+enum vr_LibmMode {
+  VR_LIBM_FAST,    /* inexact libm result moved one ulp up or down */
+  VR_LIBM_ACCURATE /* result of the wider type rounded by the mode (default) */
+};
+
 typedef struct {
   enum vr_RoundingMode default_rounding_mode;
   enum vr_RoundingMode rounding_mode;
-  unsigned int seed;
+  enum vr_NanInfMode naninf_mode;
+  uint64_t seed;
+  const char *control_file;
+  const char *instr_windows; /* op indices to perturb, see --instr-windows */
+  int hardware_rounding;     /* directed modes rounded in hardware */
+  const char *instr_ops;     /* ops to perturb, see --instr-ops */
+  enum vr_RandEngine random_engine;
+  enum vr_LibmMode libm_mode;
+  struct Vr_Rand_ *rand; /* generator drawn by the ops of the context */
 } verrou_context_t;
 
 typedef verrou_context_t verrou_conf_t;
 
+/* verrou specific interflop_call ids, away from the ones of interflop.h */
+enum vr_UserCallId {
+  /* signature: (enum FTYPES type, void *array, size_t n) */
+  VR_INEXACT_ARRAY_ID = 0x7672
+};
+
+/* sets the rounding modes and the seed, the other fields are ignored */
 void INTERFLOP_VERROU_API(configure)(verrou_conf_t conf, void *context);
+/*
+ * verrou_conf_init sets all the fields to their defaults (those of pre_init),
+ * verrou_configure_all sets all of them: conf must have been initialized by
+ * verrou_conf_init before its fields are changed.
+ */
+void verrou_conf_init(verrou_conf_t *conf);
+void verrou_configure_all(const verrou_conf_t *conf, void *context);
 void INTERFLOP_VERROU_API(finalize)(void *context);
 
 const char *INTERFLOP_VERROU_API(get_backend_name)(void);
 const char *INTERFLOP_VERROU_API(get_backend_version)(void);
 
 const char *verrou_rounding_mode_name(enum vr_RoundingMode mode);
+const char *verrou_random_engine_name(enum vr_RandEngine engine);
 
 void verrou_begin_instr(void *context);
 void verrou_end_instr(void *context);
@@ -86,8 +134,245 @@ void verrou_updatep_prandom(void);
 void verrou_updatep_prandom_double(double);
 double verrou_prandom_pvalue(void);
 
+#define VERROU_CONTROL_MAGIC 0x56524354 /* "VRCT" */
+#define VERROU_CONTROL_VERSION 1
+/* op_count index: opHash * nbTypeHash + typeHash (see vr_op.hxx) */
+#define VERROU_CONTROL_NB_OP 18
+
+/*
+ * Layout of the memory-mapped control block (--control-file). A controller
+ * process updates the control fields between two increments of sequence
+ * (odd while writing). The backend applies them at its next safe point
+ * (verrou_control_sync, called every few thousand ops) and publishes its
+ * telemetry there.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  /* control, written by the controller */
+  uint64_t sequence;
+  int32_t rounding_mode; /* enum vr_RoundingMode */
+  int32_t instrument;    /* 0: as verrou_end_instr, 1: as verrou_begin_instr */
+  uint64_t seed;         /* applied when changed */
+  double prandom_p;      /* applied when >= 0 */
+  /* telemetry, written by the backend */
+  uint64_t applied_sequence;
+  uint64_t nb_sync;
+  uint64_t op_count[VERROU_CONTROL_NB_OP];
+} verrou_control_t;
+
+void verrou_control_sync(void *context);
+
+#define VERROU_FORK_PARENT (-1)
+
+/*
+ * Fork server: to be called once the application is initialized. Forks
+ * nb_samples children (at most nb_parallel at once, 0 for all), each one
+ * reseeded with verrou_derive_seed(current seed, sample) by a pthread_atfork
+ * handler. Returns the sample index in each child. The parent waits for all
+ * of them, stores the number of failed samples in *nb_failed and returns
+ * VERROU_FORK_PARENT. Stdio buffers should be flushed before the call.
+ */
+int verrou_fork_samples(unsigned int nb_samples, unsigned int nb_parallel,
+                        unsigned int *nb_failed);
+uint64_t verrou_derive_seed(uint64_t seed, unsigned int sample);
+
+/*
+ * Samples as threads of one process. verrou_thread_context_new returns a
+ * copy of context with its own rounding mode, seed and generator: the ops
+ * called with it, through the table of verrou_thread_backend or the
+ * reductions, only use its state. verrou_bind_thread makes it the context of
+ * the calling thread for the entry points which are not given one (libm,
+ * verrou_inexact_array_*, verrou_set_seed, the prandom parameter and the
+ * generator of the value backends); NULL restores the process context. The
+ * rounding mode of the value entries is the one of their table: a bound
+ * thread calls the ones of verrou_thread_value_backend. The seeds of the
+ * samples may be derived with verrou_derive_seed.
+ */
+void *verrou_thread_context_new(void *context, enum vr_RoundingMode mode,
+                                uint64_t seed);
+void verrou_thread_context_free(void *context);
+struct interflop_backend_interface_t verrou_thread_backend(void *context);
+void verrou_bind_thread(void *context);
+
+#define VERROU_STORE_MAGIC 0x56525354 /* "VRST" */
+#define VERROU_STORE_VERSION 1
+#define VERROU_STORE_NB_ARRAY 64
+#define VERROU_STORE_NAME_SIZE 64
+
+/*
+ * Layout of the memory-mapped result store. Each sample publishes named
+ * double arrays (verrou_store_publish) which are reduced in place, element
+ * by element, with the Welford update of the mean and of the sum of squared
+ * deviations m2, so that the statistics are complete as soon as the last
+ * sample has published. The arrays are allocated in the element area at
+ * their first publication.
+ */
+typedef struct {
+  double mean;
+  double m2; /* variance: m2 / (nb_sample - 1) */
+} verrou_store_element_t;
+
+typedef struct {
+  char name[VERROU_STORE_NAME_SIZE];
+  uint32_t lock;
+  uint32_t pad;
+  uint64_t size;   /* number of elements */
+  uint64_t offset; /* of the first element in the element area */
+  uint64_t nb_sample;
+} verrou_store_array_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t lock; /* allocation of the arrays */
+  uint32_t nb_array;
+  uint64_t capacity; /* size of the element area */
+  uint64_t used;
+  verrou_store_array_t arrays[VERROU_STORE_NB_ARRAY];
+  /* followed by capacity verrou_store_element_t */
+} verrou_store_t;
+
+/*
+ * Maps the store backing path, created with room for capacity elements if
+ * it does not exist yet, so that separate processes can share it. With a
+ * NULL path, the store is an anonymous shared mapping, inherited by the
+ * samples of verrou_fork_samples. Returns 0 on success.
+ */
+int verrou_store_open(const char *path, size_t capacity);
+void verrou_store_close(void);
+/* Returns 0 on success, -1 if the store is full or n does not match. */
+int verrou_store_publish(const char *name, const double *x, size_t n);
+/*
+ * Copies the statistics of the array name (any output may be NULL) and
+ * returns its number of samples, -1 if the array is unknown. The significant
+ * digits are -log10(stddev / |mean|), in [0, 15.95].
+ */
+long verrou_store_read(const char *name, double *mean, double *variance,
+                       double *digits, size_t n);
+
+void verrou_inexact_array_double(double *x, size_t n);
+void verrou_inexact_array_float(float *x, size_t n);
+
+/*
+ * Instrumented reductions. Each step is rounded as the corresponding op
+ * (add for sum, fma for dot, norm2 and axpy) in the current rounding mode,
+ * but the sum and dot products interleave VR_REDUCTION_NB_CHAIN (4)
+ * accumulators combined pairwise at the end: the order of the operations is
+ * not the one of a sequential loop.
+ */
+double verrou_sum_double(const double *x, size_t n, void *context);
+float verrou_sum_float(const float *x, size_t n, void *context);
+double verrou_dot_double(const double *x, const double *y, size_t n,
+                         void *context);
+float verrou_dot_float(const float *x, const float *y, size_t n, void *context);
+double verrou_norm2_double(const double *x, size_t n, void *context);
+float verrou_norm2_float(const float *x, size_t n, void *context);
+void verrou_axpy_double(double a, const double *x, double *y, size_t n,
+                        void *context);
+void verrou_axpy_float(float a, const float *x, float *y, size_t n,
+                       void *context);
+
+/*
+ * Shadow values, to estimate the rounding error in a single run: value is
+ * computed by the instrumented ops in the rounding mode of the context, and
+ * hi + lo is a double-double companion carried alongside by the same
+ * computation done accurately. The reductions return the instrumented result
+ * of verrou_sum_double, verrou_dot_double or verrou_norm2_double paired with
+ * its double-double evaluation.
+ */
+typedef struct {
+  double value;
+  double hi;
+  double lo;
+} verrou_shadow_t;
+
+#define VERROU_SHADOW_NB_CHECKPOINT 64
+#define VERROU_SHADOW_NAME_SIZE 64
+
+verrou_shadow_t verrou_shadow(double x);
+verrou_shadow_t verrou_shadow_add(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context);
+verrou_shadow_t verrou_shadow_sub(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context);
+verrou_shadow_t verrou_shadow_mul(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context);
+verrou_shadow_t verrou_shadow_div(verrou_shadow_t a, verrou_shadow_t b,
+                                  void *context);
+verrou_shadow_t verrou_shadow_fma(verrou_shadow_t a, verrou_shadow_t b,
+                                  verrou_shadow_t c, void *context);
+verrou_shadow_t verrou_shadow_sum(const double *x, size_t n, void *context);
+verrou_shadow_t verrou_shadow_dot(const double *x, const double *y, size_t n,
+                                  void *context);
+verrou_shadow_t verrou_shadow_norm2(const double *x, size_t n, void *context);
+/* relative error of value with respect to hi + lo */
+double verrou_shadow_error(verrou_shadow_t x);
+/*
+ * Returns the largest relative error of the n values of x, also recorded
+ * under the checkpoint name (at most VERROU_SHADOW_NB_CHECKPOINT names of
+ * less than VERROU_SHADOW_NAME_SIZE characters) and reported at finalize by
+ * verrou_print_shadow_checkpoints.
+ */
+double verrou_shadow_checkpoint(const char *name, const verrou_shadow_t *x,
+                                size_t n);
+void verrou_print_shadow_checkpoints(void);
+
+/*
+ * Op kernels of the static backends under stable names, for compiler-based
+ * instrumentation: interflop_verrou_<mode>_<op> has the signature of the
+ * matching interflop_backend_interface_t entry (e.g.
+ * interflop_verrou_random_det_add_double). With --enable-verrou-bitcode the
+ * backend is also built as LLVM bitcode (libinterflop_verrou.bc), so that a
+ * pass can link these kernels into the application and inline them instead
+ * of calling through the backend table.
+ */
+#define VERROU_KERNEL_MODES(X)                                                 \
+  X(nearest)                                                                   \
+  X(upward)                                                                    \
+  X(downward)                                                                  \
+  X(zero)                                                                      \
+  X(random)                                                                    \
+  X(random_det)                                                                \
+  X(random_comdet)                                                             \
+  X(average)                                                                   \
+  X(average_det)                                                               \
+  X(average_comdet)                                                            \
+  X(prandom)                                                                   \
+  X(prandom_det)                                                               \
+  X(prandom_comdet)                                                            \
+  X(farthest)                                                                  \
+  X(float)
+
+#define VERROU_KERNEL_DECLARE(MODE)                                            \
+  void INTERFLOP_VERROU_API(MODE##_add_double)(double, double, double *,       \
+                                               void *);                        \
+  void INTERFLOP_VERROU_API(MODE##_add_float)(float, float, float *, void *);  \
+  void INTERFLOP_VERROU_API(MODE##_sub_double)(double, double, double *,       \
+                                               void *);                        \
+  void INTERFLOP_VERROU_API(MODE##_sub_float)(float, float, float *, void *);  \
+  void INTERFLOP_VERROU_API(MODE##_mul_double)(double, double, double *,       \
+                                               void *);                        \
+  void INTERFLOP_VERROU_API(MODE##_mul_float)(float, float, float *, void *);  \
+  void INTERFLOP_VERROU_API(MODE##_div_double)(double, double, double *,       \
+                                               void *);                        \
+  void INTERFLOP_VERROU_API(MODE##_div_float)(float, float, float *, void *);  \
+  void INTERFLOP_VERROU_API(MODE##_cast_double_to_float)(double, float *,      \
+                                                         void *);              \
+  void INTERFLOP_VERROU_API(MODE##_fma_double)(double, double, double,         \
+                                               double *, void *);              \
+  void INTERFLOP_VERROU_API(MODE##_fma_float)(float, float, float, float *,    \
+                                              void *);
+
+VERROU_KERNEL_MODES(VERROU_KERNEL_DECLARE)
+
 void verrou_init_profiling_exact(void);
 void verrou_get_profiling_exact(unsigned int *num, unsigned int *numExact);
+void verrou_init_profiling_events(void);
+void verrou_print_profiling_events(void);
+void verrou_init_profiling_sites(void);
+void verrou_print_profiling_sites(void);
+/* ranks the double call sites by how safely they could be demoted to float */
+void verrou_print_precision_advice(void);
 void INTERFLOP_VERROU_API(user_call)(void *context, interflop_call_id id,
                                      va_list ap);
 void INTERFLOP_VERROU_API(pre_init)(File *stream, interflop_panic_t panic,
@@ -119,6 +404,101 @@ void INTERFLOP_VERROU_API(fma_double)(double a, double b, double c, double *res,
 void INTERFLOP_VERROU_API(fma_float)(float a, float b, float c, float *res,
                                      void *context);
 
+/*
+ * Same ops returning the result by value, so that it can stay in a register
+ * across a chain of instrumented ops instead of being stored and reloaded.
+ */
+double INTERFLOP_VERROU_API(add_double_value)(double a, double b,
+                                              void *context);
+float INTERFLOP_VERROU_API(add_float_value)(float a, float b, void *context);
+double INTERFLOP_VERROU_API(sub_double_value)(double a, double b,
+                                              void *context);
+float INTERFLOP_VERROU_API(sub_float_value)(float a, float b, void *context);
+double INTERFLOP_VERROU_API(mul_double_value)(double a, double b,
+                                              void *context);
+float INTERFLOP_VERROU_API(mul_float_value)(float a, float b, void *context);
+double INTERFLOP_VERROU_API(div_double_value)(double a, double b,
+                                              void *context);
+float INTERFLOP_VERROU_API(div_float_value)(float a, float b, void *context);
+float INTERFLOP_VERROU_API(cast_double_to_float_value)(double a,
+                                                       void *context);
+double INTERFLOP_VERROU_API(fma_double_value)(double a, double b, double c,
+                                              void *context);
+float INTERFLOP_VERROU_API(fma_float_value)(float a, float b, float c,
+                                            void *context);
+
+/*
+ * Backend table returning results by value. The static backends do not use
+ * the context, so the entries do not take it: when the configuration needs
+ * the dynamic backend (--control-file), they call the *_value entry points
+ * above with the context given to value_backend.
+ */
+typedef struct {
+  float (*add_float)(float a, float b);
+  float (*sub_float)(float a, float b);
+  float (*mul_float)(float a, float b);
+  float (*div_float)(float a, float b);
+  double (*add_double)(double a, double b);
+  double (*sub_double)(double a, double b);
+  double (*mul_double)(double a, double b);
+  double (*div_double)(double a, double b);
+  float (*cast_double_to_float)(double a);
+  float (*fma_float)(float a, float b, float c);
+  double (*fma_double)(double a, double b, double c);
+} verrou_value_backend_t;
+
+/* to be called after init, with the same context */
+verrou_value_backend_t INTERFLOP_VERROU_API(value_backend)(void *context);
+/*
+ * value entries with the rounding mode of a context of
+ * verrou_thread_context_new, for the threads bound to it
+ */
+verrou_value_backend_t verrou_thread_value_backend(void *context);
+
+/*
+ * libm functions with the rounding mode of the backend applied to their
+ * result (built with VERROU_LIBM, see --enable-verrou-libm): verrou_libm_NAME
+ * and verrou_libm_NAMEf, and the array variants computing x[i] = NAME(x[i])
+ * (or NAME(x[i], y[i])) in place. They use the context of the last init, and
+ * are native before. With --libm=fast, the random modes move the inexact
+ * libm results one ulp up or down instead of evaluating the function in a
+ * wider type. libinterflop_verrou_libm, to be preloaded, interposes the libm
+ * functions of the application with them.
+ */
+#define VERROU_LIBM_FUNCTIONS_1(F)                                             \
+  F(exp) F(exp2) F(expm1) F(log) F(log2) F(log10) F(log1p) F(sin) F(cos)       \
+      F(tan) F(asin) F(acos) F(atan) F(sinh) F(cosh) F(tanh) F(cbrt) F(erf)
+#define VERROU_LIBM_FUNCTIONS_2(F) F(pow) F(atan2) F(hypot)
+
+#define VERROU_LIBM_DECLARE_1(NAME)                                            \
+  double verrou_libm_##NAME(double x);                                         \
+  float verrou_libm_##NAME##f(float x);                                        \
+  void verrou_libm_##NAME##_array(double *x, size_t n);                        \
+  void verrou_libm_##NAME##f_array(float *x, size_t n);
+#define VERROU_LIBM_DECLARE_2(NAME)                                            \
+  double verrou_libm_##NAME(double x, double y);                               \
+  float verrou_libm_##NAME##f(float x, float y);                               \
+  void verrou_libm_##NAME##_array(double *x, const double *y, size_t n);       \
+  void verrou_libm_##NAME##f_array(float *x, const float *y, size_t n);
+VERROU_LIBM_FUNCTIONS_1(VERROU_LIBM_DECLARE_1)
+VERROU_LIBM_FUNCTIONS_2(VERROU_LIBM_DECLARE_2)
+
+#define VERROU_LIBM_FIELD_1(NAME)                                              \
+  double (*NAME)(double x);                                                    \
+  float (*NAME##f)(float x);
+#define VERROU_LIBM_FIELD_2(NAME)                                              \
+  double (*NAME)(double x, double y);                                          \
+  float (*NAME##f)(float x, float y);
+
+/* the scalar functions, given by init to verrou_libm_register */
+typedef struct {
+  VERROU_LIBM_FUNCTIONS_1(VERROU_LIBM_FIELD_1)
+  VERROU_LIBM_FUNCTIONS_2(VERROU_LIBM_FIELD_2)
+} verrou_libm_backend_t;
+
+/* defined by libinterflop_verrou_libm */
+void verrou_libm_register(const verrou_libm_backend_t *backend);
+
 void INTERFLOP_VERROU_API(finalize)(void *context);
 
 #ifdef __cplusplus
@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Interposition of the libm functions.                         ---*/
+/*---                                   interflop_verrou_libm.cxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+
+/*
+ * To be preloaded (LD_PRELOAD) in the application: the libm functions of
+ * VERROU_LIBM_FUNCTIONS_1 and _2 call the entry points of the backend given
+ * by its init (verrou_libm_register), the libm ones until then. The backend
+ * resolves its own libm calls (to compute the result and its error) in the
+ * libm, so a direct call of its verrou_libm_* entry points is not rounded
+ * twice.
+ */
+
+#include <dlfcn.h>
+#include <stddef.h>
+
+#include "interflop_verrou.h"
+
+static verrou_libm_backend_t vr_libmBackend;
+// set while in the backend, whose libm calls are native
+static __thread int vr_libmInside __attribute__((tls_model("initial-exec")));
+
+extern "C" void verrou_libm_register(const verrou_libm_backend_t *backend) {
+  vr_libmBackend = *backend;
+}
+
+// the libm function NAME, resolved on first use
+#define VR_LIBM_NEXT(NAME)                                                     \
+  static TYPE_##NAME next = NULL;                                              \
+  if (next == NULL) {                                                          \
+    next = (TYPE_##NAME)dlsym(RTLD_NEXT, #NAME);                               \
+  }
+
+#define VR_LIBM_INTERPOSE(NAME, REAL, PARAMS, ARGS)                            \
+  typedef REAL(*TYPE_##NAME) PARAMS;                                           \
+  extern "C" REAL NAME PARAMS noexcept {                                       \
+    if (vr_libmBackend.NAME != NULL && !vr_libmInside) {                       \
+      vr_libmInside = 1;                                                       \
+      const REAL res = vr_libmBackend.NAME ARGS;                               \
+      vr_libmInside = 0;                                                       \
+      return res;                                                              \
+    }                                                                          \
+    VR_LIBM_NEXT(NAME);                                                        \
+    return next ARGS;                                                          \
+  }
+
+#define VR_LIBM_INTERPOSE_1(NAME)                                              \
+  VR_LIBM_INTERPOSE(NAME, double, (double x), (x))                             \
+  VR_LIBM_INTERPOSE(NAME##f, float, (float x), (x))
+#define VR_LIBM_INTERPOSE_2(NAME)                                              \
+  VR_LIBM_INTERPOSE(NAME, double, (double x, double y), (x, y))                \
+  VR_LIBM_INTERPOSE(NAME##f, float, (float x, float y), (x, y))
+
+VERROU_LIBM_FUNCTIONS_1(VR_LIBM_INTERPOSE_1)
+VERROU_LIBM_FUNCTIONS_2(VR_LIBM_INTERPOSE_2)
@@ -3,18 +3,65 @@
 #include "vr_op.hxx"
 #include "vr_rand.h"
 
+#ifndef VERROU_DET_HASH_CACHE
+#define VERROU_DET_HASH_CACHE 0
+#endif
+
+/*
+ * With VERROU_DET_HASH_CACHE > 0, the words drawn by vr_mersenne_twister_hash
+ * are memoized in a per-thread direct-mapped cache of VERROU_DET_HASH_CACHE
+ * entries (a power of 2), keyed by the seed, the op and the bits of the
+ * arguments: an op repeated with the same arguments skips the initialization
+ * of tinymt64. The hash being a function of this key, results are unchanged.
+ */
+struct vr_detHashCacheEntry_t {
+  uint64_t args[3];
+  uint64_t seed;
+  uint32_t hashOp;
+  uint32_t kind; // 0 for an empty entry, else the vr_detHashKind of word
+  uint64_t word;
+};
+
+struct vr_detHashCache_t {
+  vr_detHashCacheEntry_t entries[VERROU_DET_HASH_CACHE > 0
+                                     ? VERROU_DET_HASH_CACHE
+                                     : 1];
+  uint64_t nbHit;
+  uint64_t nbMiss;
+  vr_detHashCache_t *next; // list of the caches of all threads
+};
+
+extern __thread vr_detHashCache_t *vr_detHashThreadCache
+    __attribute__((tls_model("initial-exec")));
+
+// cache of the current thread, allocated on first use
+extern "C" vr_detHashCache_t *vr_det_hash_cache_alloc(void)
+    __attribute__((cold));
+
 class vr_mersenne_twister_hash {
 public:
   typedef vr_mersenne_twister_hash mersenneHash;
 
+  // keyed directly by the seed: nothing to rebuild on reseed
+  static inline void setKey(__attribute__((unused)) const Vr_Rand *r) {}
+
   template <class REALTYPE, int NB>
   static inline bool hashBool(const Vr_Rand *r,
                               const vr_packArg<REALTYPE, NB> &pack,
                               uint32_t hashOp) {
     uint64_t seed = vr_rand_getSeed(r);
+#if VERROU_DET_HASH_CACHE > 0
+    vr_detHashCacheEntry_t *entry;
+    if (mersenneHash::lookup(pack, seed, hashOp, VR_DET_HASH_BOOL, &entry)) {
+      return entry->word;
+    }
+#endif
     tinymt64_t localGen;
     mersenneHash::setGen(localGen, pack, seed ^ hashOp);
     uint32_t res = tinymt64_generate_uint64(&localGen);
+#if VERROU_DET_HASH_CACHE > 0
+    entry->word = res >> 31;
+#endif
     return (res >> 31);
   };
 
@@ -23,12 +70,90 @@ public:
                                  const vr_packArg<REALTYPE, NB> &pack,
                                  uint32_t hashOp) {
     uint64_t seed = vr_rand_getSeed(r);
+#if VERROU_DET_HASH_CACHE > 0
+    vr_detHashCacheEntry_t *entry;
+    if (mersenneHash::lookup(pack, seed, hashOp, VR_DET_HASH_RATIO, &entry)) {
+      double ratio;
+      __builtin_memcpy(&ratio, &entry->word, sizeof(ratio));
+      return ratio;
+    }
+#endif
     tinymt64_t localGen;
     mersenneHash::setGen(localGen, pack, seed ^ hashOp);
-    return tinymt64_generate_doubleOO(&localGen);
+    const double ratio = tinymt64_generate_doubleOO(&localGen);
+#if VERROU_DET_HASH_CACHE > 0
+    __builtin_memcpy(&entry->word, &ratio, sizeof(ratio));
+#endif
+    return ratio;
   };
 
 private:
+  // a rounding mode draws only one kind, but both may share a cache
+  enum vr_detHashKind { VR_DET_HASH_BOOL = 1, VR_DET_HASH_RATIO = 2 };
+
+  static inline uint64_t argBits(const float &x) {
+    return realToUint32_reinterpret_cast(x);
+  }
+  static inline uint64_t argBits(const double &x) {
+    return realToUint64_reinterpret_cast<double>(x);
+  }
+
+  template <class REALTYPE>
+  static inline void setArgs(uint64_t *args,
+                             const vr_packArg<REALTYPE, 1> &pack) {
+    args[0] = argBits(pack.arg1);
+    args[1] = 0;
+    args[2] = 0;
+  }
+  template <class REALTYPE>
+  static inline void setArgs(uint64_t *args,
+                             const vr_packArg<REALTYPE, 2> &pack) {
+    args[0] = argBits(pack.arg1);
+    args[1] = argBits(pack.arg2);
+    args[2] = 0;
+  }
+  template <class REALTYPE>
+  static inline void setArgs(uint64_t *args,
+                             const vr_packArg<REALTYPE, 3> &pack) {
+    args[0] = argBits(pack.arg1);
+    args[1] = argBits(pack.arg2);
+    args[2] = argBits(pack.arg3);
+  }
+
+  // true on a hit. On a miss, *entry is set to the key, its word is left to
+  // the caller.
+  template <class REALTYPE, int NB>
+  static inline bool lookup(const vr_packArg<REALTYPE, NB> &pack,
+                            uint64_t seed, uint32_t hashOp, uint32_t kind,
+                            vr_detHashCacheEntry_t **entry) {
+    vr_detHashCache_t *cache = vr_detHashThreadCache;
+    if (__builtin_expect(cache == NULL, 0)) {
+      cache = vr_det_hash_cache_alloc();
+    }
+    uint64_t args[3];
+    mersenneHash::setArgs(args, pack);
+    const uint64_t h =
+        vr_rand_mix64(args[0] ^ (args[1] * 0x9E3779B97F4A7C15ULL) ^
+                      (args[2] * 0xC2B2AE3D27D4EB4FULL) ^ hashOp);
+    vr_detHashCacheEntry_t *e =
+        &cache->entries[h & (VERROU_DET_HASH_CACHE - 1)];
+    *entry = e;
+    if (e->kind == kind && e->hashOp == hashOp && e->seed == seed &&
+        e->args[0] == args[0] && e->args[1] == args[1] &&
+        e->args[2] == args[2]) {
+      cache->nbHit++;
+      return true;
+    }
+    cache->nbMiss++;
+    e->args[0] = args[0];
+    e->args[1] = args[1];
+    e->args[2] = args[2];
+    e->seed = seed;
+    e->hashOp = hashOp;
+    e->kind = kind;
+    return false;
+  }
+
   template <class REALTYPE>
   static inline void
   setGen(tinymt64_t &gen, const vr_packArg<REALTYPE, 1> &pack, uint64_t seed) {
@@ -2,11 +2,13 @@
 
 #include "vr_op.hxx"
 #include "vr_roundingOp.hxx"
+#include "vr_window.hxx"
 
 template <typename> class Void {};
 
 template <template <typename O, typename R> typename RoundingMode,
-          template <typename T> typename RAND = Void>
+          template <typename T> typename RAND = Void,
+          class NANINF = vr_nanInfIgnore>
 class StaticRounding {
   using AD = AddOp<double>;
   using AF = AddOp<float>;
@@ -21,61 +23,117 @@ class StaticRounding {
   using FF = MAddOp<float>;
 
 public:
-  static void add_double(double a, double b, double *res, void *context) {
-    // typedef typename RoundingMode<AD, RAND<AD>> Op;
-    using Op = RoundingMode<AD, RAND<AD>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  // shared by the pointer and value kernels and inlined in the wrappers of
+  // vr_windowBackend, for RECORD_SITE
+  template <class OP>
+  __attribute__((always_inline)) static inline typename OP::RealType
+  apply(const typename OP::PackArgs &p, Vr_Rand *rand) {
+    using Op = RoundingMode<OP, RAND<OP>>;
+    const typename OP::RealType res = Op::apply(p, rand);
+    NANINF::template check<OP>(p, res);
+    RECORD_EVENTS(OP, p, res);
+    RECORD_SITE(OP, p, res);
+    return res;
+  }
+
+  VR_MULTIARCH_KERNEL static void add_double(double a, double b, double *res,
+                                             void *context) {
+    *res = apply<AD>(typename AD::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void add_float(float a, float b, float *res,
+                                            void *context) {
+    *res = apply<AF>(typename AF::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void sub_double(double a, double b, double *res,
+                                             void *context) {
+    *res = apply<SD>(typename SD::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void sub_float(float a, float b, float *res,
+                                            void *context) {
+    *res = apply<SF>(typename SF::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void mul_double(double a, double b, double *res,
+                                             void *context) {
+    *res = apply<MD>(typename MD::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void mul_float(float a, float b, float *res,
+                                            void *context) {
+    *res = apply<MF>(typename MF::PackArgs(a, b), vr_contextRand(context));
+  }
+
+  VR_MULTIARCH_KERNEL static void div_double(double a, double b, double *res,
+                                             void *context) {
+    *res = apply<DD>(typename DD::PackArgs(a, b), vr_contextRand(context));
   }
 
-  static void add_float(float a, float b, float *res, void *context) {
-    using Op = RoundingMode<AF, RAND<AF>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static void div_float(float a, float b, float *res,
+                                            void *context) {
+    *res = apply<DF>(typename DF::PackArgs(a, b), vr_contextRand(context));
   }
 
-  static void sub_double(double a, double b, double *res, void *context) {
-    using Op = RoundingMode<SD, RAND<SD>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static void cast_double_to_float(double a, float *res,
+                                                       void *context) {
+    *res = apply<CDF>(typename CDF::PackArgs(a), vr_contextRand(context));
   }
 
-  static void sub_float(float a, float b, float *res, void *context) {
-    using Op = RoundingMode<SF, RAND<SF>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static void fma_double(double a, double b, double c,
+                                             double *res, void *context) {
+    *res = apply<FD>(typename FD::PackArgs(a, b, c), vr_contextRand(context));
   }
 
-  static void mul_double(double a, double b, double *res, void *context) {
-    using Op = RoundingMode<MD, RAND<MD>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static void fma_float(float a, float b, float c,
+                                            float *res, void *context) {
+    *res = apply<FF>(typename FF::PackArgs(a, b, c), vr_contextRand(context));
   }
 
-  static void mul_float(float a, float b, float *res, void *context) {
-    using Op = RoundingMode<MF, RAND<MF>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static double add_double_value(double a, double b) {
+    return apply<AD>(typename AD::PackArgs(a, b), vr_boundRand());
   }
 
-  static void div_double(double a, double b, double *res, void *context) {
-    using Op = RoundingMode<DD, RAND<DD>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static float add_float_value(float a, float b) {
+    return apply<AF>(typename AF::PackArgs(a, b), vr_boundRand());
   }
 
-  static void div_float(float a, float b, float *res, void *context) {
-    using Op = RoundingMode<DF, RAND<DF>>;
-    *res = Op::apply(typename Op::PackArgs(a, b));
+  VR_MULTIARCH_KERNEL static double sub_double_value(double a, double b) {
+    return apply<SD>(typename SD::PackArgs(a, b), vr_boundRand());
   }
 
-  static void cast_double_to_float(double a, float *res, void *context) {
-    using Op = RoundingMode<CDF, RAND<CDF>>;
-    *res = Op::apply(typename Op::PackArgs(a));
+  VR_MULTIARCH_KERNEL static float sub_float_value(float a, float b) {
+    return apply<SF>(typename SF::PackArgs(a, b), vr_boundRand());
   }
 
-  static void fma_double(double a, double b, double c, double *res,
-                         void *context) {
-    using Op = RoundingMode<FD, RAND<FD>>;
-    *res = Op::apply(typename Op::PackArgs(a, b, c));
+  VR_MULTIARCH_KERNEL static double mul_double_value(double a, double b) {
+    return apply<MD>(typename MD::PackArgs(a, b), vr_boundRand());
   }
 
-  static void fma_float(float a, float b, float c, float *res, void *context) {
-    using Op = RoundingMode<FF, RAND<FF>>;
-    *res = Op::apply(typename Op::PackArgs(a, b, c));
+  VR_MULTIARCH_KERNEL static float mul_float_value(float a, float b) {
+    return apply<MF>(typename MF::PackArgs(a, b), vr_boundRand());
+  }
+
+  VR_MULTIARCH_KERNEL static double div_double_value(double a, double b) {
+    return apply<DD>(typename DD::PackArgs(a, b), vr_boundRand());
+  }
+
+  VR_MULTIARCH_KERNEL static float div_float_value(float a, float b) {
+    return apply<DF>(typename DF::PackArgs(a, b), vr_boundRand());
+  }
+
+  VR_MULTIARCH_KERNEL static float cast_double_to_float_value(double a) {
+    return apply<CDF>(typename CDF::PackArgs(a), vr_boundRand());
+  }
+
+  VR_MULTIARCH_KERNEL static double fma_double_value(double a, double b,
+                                                     double c) {
+    return apply<FD>(typename FD::PackArgs(a, b, c), vr_boundRand());
+  }
+
+  VR_MULTIARCH_KERNEL static float fma_float_value(float a, float b, float c) {
+    return apply<FF>(typename FF::PackArgs(a, b, c), vr_boundRand());
   }
 
   static struct interflop_backend_interface_t get_backend(void) {
@@ -99,6 +157,22 @@ public:
       interflop_finalize : INTERFLOP_VERROU_API(finalize)
     };
   }
+
+  static verrou_value_backend_t get_value_backend(void) {
+    return {
+      add_float : add_float_value,
+      sub_float : sub_float_value,
+      mul_float : mul_float_value,
+      div_float : div_float_value,
+      add_double : add_double_value,
+      sub_double : sub_double_value,
+      mul_double : mul_double_value,
+      div_double : div_double_value,
+      cast_double_to_float : cast_double_to_float_value,
+      fma_float : fma_float_value,
+      fma_double : fma_double_value
+    };
+  }
 };
 
 interflop_backend_interface_t dynamic_backend = {
@@ -121,44 +195,252 @@ interflop_backend_interface_t dynamic_backend = {
   interflop_finalize : INTERFLOP_VERROU_API(finalize)
 };
 
-static struct interflop_backend_interface_t
-get_static_backend(verrou_context_t *ctx) {
+// value entries of the dynamic backend, bound to the context given to
+// interflop_verrou_value_backend
+static void *vr_valueContext = NULL;
+
+// applied here rather than through the API entry points, so that RECORD_SITE
+// sees the caller of the thunk
+template <class OP>
+__attribute__((always_inline)) static inline typename OP::RealType
+vr_dynamicValue(const typename OP::PackArgs &p) {
+  typename OP::RealType res;
+  OpWithSelectedRoundingMode<OP>::apply(p, &res,
+                                        vr_boundContext(vr_valueContext));
+  return res;
+}
+
+static double vr_dynamic_add_double_value(double a, double b) {
+  return vr_dynamicValue<AddOp<double>>(AddOp<double>::PackArgs(a, b));
+}
+static float vr_dynamic_add_float_value(float a, float b) {
+  return vr_dynamicValue<AddOp<float>>(AddOp<float>::PackArgs(a, b));
+}
+static double vr_dynamic_sub_double_value(double a, double b) {
+  return vr_dynamicValue<SubOp<double>>(SubOp<double>::PackArgs(a, b));
+}
+static float vr_dynamic_sub_float_value(float a, float b) {
+  return vr_dynamicValue<SubOp<float>>(SubOp<float>::PackArgs(a, b));
+}
+static double vr_dynamic_mul_double_value(double a, double b) {
+  return vr_dynamicValue<MulOp<double>>(MulOp<double>::PackArgs(a, b));
+}
+static float vr_dynamic_mul_float_value(float a, float b) {
+  return vr_dynamicValue<MulOp<float>>(MulOp<float>::PackArgs(a, b));
+}
+static double vr_dynamic_div_double_value(double a, double b) {
+  return vr_dynamicValue<DivOp<double>>(DivOp<double>::PackArgs(a, b));
+}
+static float vr_dynamic_div_float_value(float a, float b) {
+  return vr_dynamicValue<DivOp<float>>(DivOp<float>::PackArgs(a, b));
+}
+static float vr_dynamic_cast_double_to_float_value(double a) {
+  typedef CastOp<double, float> CDF;
+  return vr_dynamicValue<CDF>(CDF::PackArgs(a));
+}
+static double vr_dynamic_fma_double_value(double a, double b, double c) {
+  return vr_dynamicValue<MAddOp<double>>(MAddOp<double>::PackArgs(a, b, c));
+}
+static float vr_dynamic_fma_float_value(float a, float b, float c) {
+  return vr_dynamicValue<MAddOp<float>>(MAddOp<float>::PackArgs(a, b, c));
+}
+
+verrou_value_backend_t dynamic_value_backend = {
+  add_float : vr_dynamic_add_float_value,
+  sub_float : vr_dynamic_sub_float_value,
+  mul_float : vr_dynamic_mul_float_value,
+  div_float : vr_dynamic_div_float_value,
+  add_double : vr_dynamic_add_double_value,
+  sub_double : vr_dynamic_sub_double_value,
+  mul_double : vr_dynamic_mul_double_value,
+  div_double : vr_dynamic_div_double_value,
+  cast_double_to_float : vr_dynamic_cast_double_to_float_value,
+  fma_float : vr_dynamic_fma_float_value,
+  fma_double : vr_dynamic_fma_double_value
+};
+
+// vr_table<TABLE, BACKEND>::get() is the TABLE of the BACKEND class:
+// pointer results (interflop_backend_interface_t) or results by value
+// (verrou_value_backend_t)
+template <class TABLE, class BACKEND> struct vr_table;
+
+template <class BACKEND>
+struct vr_table<struct interflop_backend_interface_t, BACKEND> {
+  static struct interflop_backend_interface_t get(void) {
+    return BACKEND::get_backend();
+  }
+};
+
+template <class BACKEND> struct vr_table<verrou_value_backend_t, BACKEND> {
+  static verrou_value_backend_t get(void) {
+    return BACKEND::get_value_backend();
+  }
+};
+
+struct vr_dynamicBackend {
+  static struct interflop_backend_interface_t get_backend(void) {
+    return dynamic_backend;
+  }
+  static verrou_value_backend_t get_value_backend(void) {
+    return dynamic_value_backend;
+  }
+};
+
+// Ops whose bit OP::getHash() is not set in instrOps (--instr-ops) are
+// replaced by the native kernels when the table is built.
+#define VR_MASK_OP(OP, ENTRY)                                                  \
+  if ((instrOps & (1U << OP::getHash())) == 0) {                               \
+    table.ENTRY = native.ENTRY;                                                \
+  }
+
+static inline void vr_maskOps(struct interflop_backend_interface_t &table,
+                              uint32_t instrOps) {
+  typedef CastOp<double, float> CDF;
+  const struct interflop_backend_interface_t native =
+      StaticRounding<RoundingNearest>::get_backend();
+  VR_MASK_OP(AddOp<float>, interflop_add_float);
+  VR_MASK_OP(SubOp<float>, interflop_sub_float);
+  VR_MASK_OP(MulOp<float>, interflop_mul_float);
+  VR_MASK_OP(DivOp<float>, interflop_div_float);
+  VR_MASK_OP(AddOp<double>, interflop_add_double);
+  VR_MASK_OP(SubOp<double>, interflop_sub_double);
+  VR_MASK_OP(MulOp<double>, interflop_mul_double);
+  VR_MASK_OP(DivOp<double>, interflop_div_double);
+  VR_MASK_OP(CDF, interflop_cast_double_to_float);
+  VR_MASK_OP(MAddOp<float>, interflop_fma_float);
+  VR_MASK_OP(MAddOp<double>, interflop_fma_double);
+}
+
+static inline void vr_maskOps(verrou_value_backend_t &table,
+                              uint32_t instrOps) {
+  typedef CastOp<double, float> CDF;
+  const verrou_value_backend_t native =
+      StaticRounding<RoundingNearest>::get_value_backend();
+  VR_MASK_OP(AddOp<float>, add_float);
+  VR_MASK_OP(SubOp<float>, sub_float);
+  VR_MASK_OP(MulOp<float>, mul_float);
+  VR_MASK_OP(DivOp<float>, div_float);
+  VR_MASK_OP(AddOp<double>, add_double);
+  VR_MASK_OP(SubOp<double>, sub_double);
+  VR_MASK_OP(MulOp<double>, mul_double);
+  VR_MASK_OP(DivOp<double>, div_double);
+  VR_MASK_OP(CDF, cast_double_to_float);
+  VR_MASK_OP(MAddOp<float>, fma_float);
+  VR_MASK_OP(MAddOp<double>, fma_double);
+}
+
+// WRAP<BACKEND> is the table actually returned (see vr_window.hxx)
+template <class BACKEND> using vr_noWrap = BACKEND;
+
+template <class TABLE, class NANINF, template <class> class WRAP,
+          template <typename O, typename R> typename RoundingMode,
+          template <typename T> typename RAND = Void>
+static inline TABLE vr_staticTable(void) {
+  return vr_table<TABLE,
+                  WRAP<StaticRounding<RoundingMode, RAND, NANINF>>>::get();
+}
+
+// the prng modes have a table for each engine (--random-engine)
+template <class TABLE, class NANINF, template <class> class WRAP,
+          template <typename O, typename R> typename RoundingMode>
+static inline TABLE vr_staticPrngTable(verrou_context_t *ctx) {
+  switch (ctx->random_engine) {
+  case VR_RAND_TINYMT64:
+    break;
+  case VR_RAND_XOSHIRO256:
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingMode,
+                          vr_rand_prngXoshiro256>();
+  case VR_RAND_SFC64:
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingMode,
+                          vr_rand_prngSfc64>();
+  case VR_RAND_WYRAND:
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingMode,
+                          vr_rand_prngWyrand>();
+  }
+  return vr_staticTable<TABLE, NANINF, WRAP, RoundingMode,
+                        vr_rand_prngTinymt64>();
+}
+
+template <class TABLE, class NANINF, template <class> class WRAP>
+static TABLE get_static_backend(verrou_context_t *ctx) {
   switch (ctx->rounding_mode) {
   case VR_NEAREST:
-    return StaticRounding<RoundingNearest>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingNearest>();
   case VR_UPWARD:
-    return StaticRounding<RoundingUpward>::get_backend();
+#ifdef VR_HARDWARE_ROUNDING
+    if (ctx->hardware_rounding) {
+      return vr_staticTable<TABLE, NANINF, WRAP, RoundingUpwardHardware>();
+    }
+#endif
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingUpward>();
   case VR_DOWNWARD:
-    return StaticRounding<RoundingDownward>::get_backend();
+#ifdef VR_HARDWARE_ROUNDING
+    if (ctx->hardware_rounding) {
+      return vr_staticTable<TABLE, NANINF, WRAP, RoundingDownwardHardware>();
+    }
+#endif
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingDownward>();
   case VR_ZERO:
-    return StaticRounding<RoundingZero>::get_backend();
+#ifdef VR_HARDWARE_ROUNDING
+    if (ctx->hardware_rounding) {
+      return vr_staticTable<TABLE, NANINF, WRAP, RoundingZeroHardware>();
+    }
+#endif
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingZero>();
   case VR_RANDOM:
-    return StaticRounding<RoundingRandom, vr_rand_prng>::get_backend();
+    return vr_staticPrngTable<TABLE, NANINF, WRAP, RoundingRandom>(ctx);
   case VR_RANDOM_DET:
-    return StaticRounding<RoundingRandom, vr_rand_det>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingRandom, vr_rand_det>();
   case VR_RANDOM_COMDET:
-    return StaticRounding<RoundingRandom, vr_rand_comdet>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingRandom,
+                          vr_rand_comdet>();
   case VR_AVERAGE:
-    return StaticRounding<RoundingAverage, vr_rand_prng>::get_backend();
+    return vr_staticPrngTable<TABLE, NANINF, WRAP, RoundingAverage>(ctx);
   case VR_AVERAGE_DET:
-    return StaticRounding<RoundingAverage, vr_rand_det>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingAverage, vr_rand_det>();
   case VR_AVERAGE_COMDET:
-    return StaticRounding<RoundingAverage, vr_rand_comdet>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingAverage,
+                          vr_rand_comdet>();
   case VR_PRANDOM:
-    return StaticRounding<RoundingPRandom, vr_rand_prng>::get_backend();
+    return vr_staticPrngTable<TABLE, NANINF, WRAP, RoundingPRandom>(ctx);
   case VR_PRANDOM_DET:
-    return StaticRounding<RoundingPRandom, vr_rand_det>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingPRandom, vr_rand_det>();
   case VR_PRANDOM_COMDET:
-    return StaticRounding<RoundingPRandom, vr_rand_comdet>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingPRandom,
+                          vr_rand_comdet>();
   case VR_FARTHEST:
-    return StaticRounding<RoundingFarthest>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingFarthest>();
   case VR_FLOAT:
-    return StaticRounding<RoundingFloat>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingFloat>();
   case VR_NATIVE:
-    return StaticRounding<RoundingNearest>::get_backend();
+    return vr_staticTable<TABLE, NANINF, WRAP, RoundingNearest>();
   case VR_FTZ:
     interflop_panic("FTZ not implemented in backend_verrou");
   default:
-    return dynamic_backend;
+    return vr_table<TABLE, vr_dynamicBackend>::get();
+  }
+}
+
+template <class TABLE, template <class> class WRAP>
+static TABLE get_static_backend(verrou_context_t *ctx) {
+#ifndef VERROU_IGNORE_NANINF_CHECK
+  // the static backends never called the handlers: only the count mode adds
+  // a check to them
+  switch (ctx->naninf_mode) {
+  case VR_NANINF_COUNT:
+    return get_static_backend<TABLE, vr_nanInfCount, WRAP>(ctx);
+  case VR_NANINF_HANDLER:
+  case VR_NANINF_IGNORE:
+    break;
+  }
+#endif
+  return get_static_backend<TABLE, vr_nanInfIgnore, WRAP>(ctx);
+}
+
+// TABLE: interflop_backend_interface_t or verrou_value_backend_t
+template <class TABLE> static TABLE get_static_backend(verrou_context_t *ctx) {
+  if (ctx->instr_windows != NULL) {
+    return get_static_backend<TABLE, vr_windowBackend>(ctx);
   }
+  return get_static_backend<TABLE, vr_noWrap>(ctx);
 }
\ No newline at end of file
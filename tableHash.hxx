@@ -1,77 +1,107 @@
 #pragma once
 
+#include <pthread.h>
+
 static uint32_t hashTable[4][8][256];
 static uint32_t hashTableOp[2][256];
+// set (release) once the tables are generated, so that the threads which
+// see it set also see the tables
+static bool hashTableReady = false;
+static pthread_once_t hashTableOnce = PTHREAD_ONCE_INIT;
 
 // static uint64_t hashTwistedTable[3][8][256];
 // static uint64_t hashTwistedTableOp[2][256];
 
 class vr_tabulation_hash {
 public:
+  static constexpr uint64_t tableSeed = 0x5eed7ab1e5eed7abULL;
+
   template <class REALTYPE, int NB>
-  static inline bool hashBool(__attribute__((unused)) const Vr_Rand *r,
+  static inline bool hashBool(const Vr_Rand *r,
                               const vr_packArg<REALTYPE, NB> &pack,
                               uint32_t hashOp) {
-    const uint32_t v = vr_tabulation_hash::hash(pack, hashOp);
+    vr_tabulation_hash::checkTable();
+    const uint32_t v = vr_tabulation_hash::hash(pack, hashOp, r->hashKey_);
     return v & 1;
   }
 
   template <class REALTYPE, int NB>
-  static inline double hashRatio(__attribute__((unused)) const Vr_Rand *r,
+  static inline double hashRatio(const Vr_Rand *r,
                                  const vr_packArg<REALTYPE, NB> &pack,
                                  uint32_t hashOp) {
-    const uint32_t v = vr_tabulation_hash::hash(pack, hashOp);
+    vr_tabulation_hash::checkTable();
+    const uint32_t v = vr_tabulation_hash::hash(pack, hashOp, r->hashKey_);
     constexpr double invMax = (1. / 4294967296.);
     return ((double)v * invMax);
   }
 
+  // tables do not depend on the seed: Vr_Rand::hashKey_ is xor-ed into the
+  // hashed arguments, so that it selects the table entries (a key applied to
+  // the output would only flip every boolean decision at once). The tables
+  // are generated once, on first det-mode use
+  static inline void setKey(__attribute__((unused)) const Vr_Rand *r) {}
+
+  static inline void checkTable() {
+    if (__builtin_expect(!__atomic_load_n(&hashTableReady, __ATOMIC_ACQUIRE),
+                         0)) {
+      pthread_once(&hashTableOnce, vr_tabulation_hash::initTable);
+    }
+  }
+
+  static void initTable() {
+    tinymt64_t gen;
+    tinymt64_init(&gen, tableSeed);
+    vr_tabulation_hash::genTable(gen);
+    __atomic_store_n(&hashTableReady, true, __ATOMIC_RELEASE);
+  }
+
   static inline uint32_t hash(const vr_packArg<double, 1> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1);
+    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1) ^ key;
     vr_tabulation_hash::hash_aux(res, 0, a1);
     return res;
   }
 
   static inline uint32_t hash(const vr_packArg<float, 1> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1);
+    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1) ^ foldKey(key);
     vr_tabulation_hash::hash_aux(res, 0, a1);
     return res;
   }
 
   static inline uint32_t hash(const vr_packArg<double, 2> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1);
-    uint64_t a2 = realToUint64_reinterpret_cast<double>(pack.arg2);
+    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1) ^ key;
+    uint64_t a2 = realToUint64_reinterpret_cast<double>(pack.arg2) ^ key;
     vr_tabulation_hash::hash_aux(res, 0, a1);
     vr_tabulation_hash::hash_aux(res, 1, a2);
     return res;
   }
 
   static inline uint32_t hash(const vr_packArg<float, 2> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1);
-    uint32_t a2 = realToUint32_reinterpret_cast(pack.arg2);
+    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1) ^ foldKey(key);
+    uint32_t a2 = realToUint32_reinterpret_cast(pack.arg2) ^ foldKey(key);
     vr_tabulation_hash::hash_aux(res, 0, a1);
     vr_tabulation_hash::hash_aux(res, 1, a2);
     return res;
   }
 
   static inline uint32_t hash(const vr_packArg<double, 3> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1);
-    uint64_t a2 = realToUint64_reinterpret_cast<double>(pack.arg2);
-    uint64_t a3 = realToUint64_reinterpret_cast<double>(pack.arg3);
+    uint64_t a1 = realToUint64_reinterpret_cast<double>(pack.arg1) ^ key;
+    uint64_t a2 = realToUint64_reinterpret_cast<double>(pack.arg2) ^ key;
+    uint64_t a3 = realToUint64_reinterpret_cast<double>(pack.arg3) ^ key;
     vr_tabulation_hash::hash_aux(res, 0, a1);
     vr_tabulation_hash::hash_aux(res, 1, a2);
     vr_tabulation_hash::hash_aux(res, 2, a3);
@@ -79,18 +109,22 @@ public:
   }
 
   static inline uint32_t hash(const vr_packArg<float, 3> &pack,
-                              uint32_t hashOp) {
+                              uint32_t hashOp, uint64_t key) {
     uint32_t res = 0;
     vr_tabulation_hash::hash_op(res, (uint16_t)hashOp);
-    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1);
-    uint32_t a2 = realToUint32_reinterpret_cast(pack.arg2);
-    uint32_t a3 = realToUint32_reinterpret_cast(pack.arg3);
+    uint32_t a1 = realToUint32_reinterpret_cast(pack.arg1) ^ foldKey(key);
+    uint32_t a2 = realToUint32_reinterpret_cast(pack.arg2) ^ foldKey(key);
+    uint32_t a3 = realToUint32_reinterpret_cast(pack.arg3) ^ foldKey(key);
     vr_tabulation_hash::hash_aux(res, 0, a1);
     vr_tabulation_hash::hash_aux(res, 1, a2);
     vr_tabulation_hash::hash_aux(res, 2, a3);
     return res;
   }
 
+  static inline uint32_t foldKey(uint64_t key) {
+    return (uint32_t)(key ^ (key >> 32));
+  }
+
   static inline void hash_op(uint32_t &h, uint16_t optEnum) {
     uint32_t x(optEnum);
     uint32_t i;
@@ -296,21 +330,29 @@ public:
 
 class vr_double_tabulation_hash {
 public:
+  static inline void setKey(const Vr_Rand *r) {
+    vr_tabulation_hash::setKey(r);
+  }
+
+  // the seed key is mixed into the first level input (see
+  // vr_tabulation_hash), the second level only rehashes its output
   template <class REALTYPE, int NB>
-  static inline bool hashBool(__attribute__((unused)) const Vr_Rand *r,
+  static inline bool hashBool(const Vr_Rand *r,
                               const vr_packArg<REALTYPE, NB> &pack,
                               uint32_t hashOp) {
-    const uint32_t tmp = vr_tabulation_hash::hash(pack, hashOp);
+    vr_tabulation_hash::checkTable();
+    const uint32_t tmp = vr_tabulation_hash::hash(pack, hashOp, r->hashKey_);
     uint32_t res = 0;
     vr_tabulation_hash::hash_aux(res, 3, tmp);
     return res & 1;
   }
 
   template <class REALTYPE, int NB>
-  static inline double hashRatio(__attribute__((unused)) const Vr_Rand *r,
+  static inline double hashRatio(const Vr_Rand *r,
                                  const vr_packArg<REALTYPE, NB> &pack,
                                  uint32_t hashOp) {
-    const uint32_t tmp = vr_tabulation_hash::hash(pack, hashOp);
+    vr_tabulation_hash::checkTable();
+    const uint32_t tmp = vr_tabulation_hash::hash(pack, hashOp, r->hashKey_);
     uint32_t res = 0;
     vr_tabulation_hash::hash_aux(res, 3, tmp);
     constexpr double invMax = (1. / 4294967296.); // 2**32 = 4294967296
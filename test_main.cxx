@@ -1,60 +1,355 @@
-
-#define DEBUG_PRINT_OP
+/*
+ * Checks of the backend, run by make check: the determinism of random_det,
+ * the directed modes rounded in hardware against their emulation, and the
+ * parsers of --instr-windows and --instr-ops. Exits with the number of
+ * failed checks.
+ */
 
 #include "interflop_verrou.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
-#include <stdio.h>
+#include <limits>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+// set by init from CPUID (AVX-512F), forced off to run the software fallback
+// of the hardware tables
+extern bool vr_hardwareEmbeddedRounding;
+#endif
+
+// * interflop stdlib handlers
+
+static int test_fprintf(File *stream, const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  int res = vfprintf((FILE *)stream, format, ap);
+  va_end(ap);
+  return res;
+}
+
+static pid_t test_gettid(void) { return syscall(SYS_gettid); }
 
-void print_debug(int nbArg, const char *op, const double *a,
-                 const double *res) {
+static int test_gettimeofday(struct timeval *tv, void *tz) {
+  return gettimeofday(tv, (struct timezone *)tz);
+}
 
-  if (nbArg == 1) {
-    std::cout << op << " : " << a[0] << "->" << &res << std::endl;
+static long test_strtol(const char *nptr, char **endptr, int *error) {
+  errno = 0;
+  long res = strtol(nptr, endptr, 10);
+  *error = errno;
+  return res;
+}
+
+static double test_strtod(const char *nptr, char **endptr, int *error) {
+  errno = 0;
+  double res = strtod(nptr, endptr);
+  *error = errno;
+  return res;
+}
+
+static void test_nanInfHandler(void) {}
+
+static void test_panic(const char *msg) {
+  fprintf(stderr, "%s", msg);
+  abort();
+}
+
+static void test_set_handlers(void) {
+  interflop_set_handler("exit", (void *)exit);
+  interflop_set_handler("fprintf", (void *)test_fprintf);
+  interflop_set_handler("sprintf", (void *)sprintf);
+  interflop_set_handler("gettid", (void *)test_gettid);
+  interflop_set_handler("gettimeofday", (void *)test_gettimeofday);
+  interflop_set_handler("infHandler", (void *)test_nanInfHandler);
+  interflop_set_handler("nanHandler", (void *)test_nanInfHandler);
+  interflop_set_handler("malloc", (void *)malloc);
+  interflop_set_handler("calloc", (void *)calloc);
+  interflop_set_handler("free", (void *)free);
+  interflop_set_handler("strcasecmp", (void *)strcasecmp);
+  interflop_set_handler("strcmp", (void *)strcmp);
+  interflop_set_handler("strtol", (void *)test_strtol);
+  interflop_set_handler("strtod", (void *)test_strtod);
+  interflop_set_handler("getenv", (void *)getenv);
+}
+
+// * Helpers
+
+static int nbFailure = 0;
+
+#define TEST_CHECK(COND, ...)                                                  \
+  if (!(COND)) {                                                               \
+    fprintf(stderr, "FAILED %s:%d: ", __FILE__, __LINE__);                     \
+    fprintf(stderr, __VA_ARGS__);                                              \
+    fprintf(stderr, "\n");                                                     \
+    nbFailure++;                                                               \
   }
 
-  if (nbArg == 2) {
-    std::cout << op << " : " << a[0] << "," << a[1] << "->" << &res
-              << std::endl;
+// the table of init for a configuration, the other fields keep their defaults
+static struct interflop_backend_interface_t
+test_backend(void *context, enum vr_RoundingMode mode, int hardware,
+             const char *windows, const char *ops) {
+  verrou_conf_t conf;
+  verrou_conf_init(&conf);
+  conf.rounding_mode = mode;
+  conf.seed = 42;
+  conf.hardware_rounding = hardware;
+  conf.instr_windows = windows;
+  conf.instr_ops = ops;
+  verrou_configure_all(&conf, context);
+  return interflop_verrou_init(context);
+}
+
+// whether init rejects the configuration: the parsers exit with 42
+static bool test_rejected(void *context, const char *windows,
+                          const char *ops) {
+  fflush(NULL);
+  const pid_t pid = fork();
+  if (pid == 0) {
+    // the error message of the parser is expected
+    if (freopen("/dev/null", "w", stderr) == NULL) {
+      _exit(1);
+    }
+    test_backend(context, VR_UPWARD, 0, windows, ops);
+    _exit(0);
   }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 42;
+}
+
+// * random_det
 
-  if (nbArg == 3) {
-    std::cout << op << " : " << a[0] << "," << a[1] << "," << a[2] << "->"
-              << &res << std::endl;
+static double test_random_det_sum(void *context) {
+  struct interflop_backend_interface_t backend =
+      test_backend(context, VR_RANDOM_DET, 0, NULL, NULL);
+  double acc = 0.;
+  for (int i = 0; i < 10000; i++) {
+    backend.interflop_add_double(acc, 0.1, &acc, context);
   }
+  return acc;
+}
+
+static void test_random_det(void *context) {
+  const double acc = test_random_det_sum(context);
+  std::cout << std::setprecision(16) << "acc: " << acc << std::endl;
+  TEST_CHECK(acc == test_random_det_sum(context),
+             "random_det is not reproducible");
+}
+
+// * Directed modes rounded in hardware
+
+struct test_directedTables {
+  enum vr_RoundingMode mode;
+  const char *path;
+  struct interflop_backend_interface_t nearest, emulated, hardware;
 };
 
-int main(int argc, char **argv) {
+// the emulated result is one ulp at most from the nearest, in the direction
+// of the mode, and the hardware table agrees with it (but on signed zeros)
+template <class REAL>
+static void test_directed_check(const test_directedTables &t, const char *op,
+                                double a, double b, REAL n, REAL e, REAL h) {
+  if (e == 0) {
+    return;
+  }
+  REAL toward = std::numeric_limits<REAL>::infinity();
+  if (t.mode == VR_DOWNWARD || (t.mode == VR_ZERO && n > 0)) {
+    toward = -toward;
+  }
+  TEST_CHECK(e == n || e == std::nextafter(n, toward),
+             "%s %s(%a, %a): %a is not %a rounded %s",
+             verrou_rounding_mode_name(t.mode), op, a, b, (double)e,
+             (double)n, verrou_rounding_mode_name(t.mode));
+  TEST_CHECK(h == e, "%s %s(%a, %a): hardware %a, emulated %a (%s)",
+             verrou_rounding_mode_name(t.mode), op, a, b, (double)h,
+             (double)e, t.path);
+}
 
-  void *context;
-  struct interflop_backend_interface_t ifverrou =
-      interflop_verrou_init(&context);
+#define TEST_DIRECTED(OP, REAL, A, B, ...)                                     \
+  {                                                                            \
+    REAL n, e, h;                                                              \
+    t.nearest.interflop_##OP(__VA_ARGS__, &n, context);                        \
+    t.emulated.interflop_##OP(__VA_ARGS__, &e, context);                       \
+    t.hardware.interflop_##OP(__VA_ARGS__, &h, context);                       \
+    test_directed_check<REAL>(t, #OP, A, B, n, e, h);                          \
+  }
 
-  interflop_verrou_configure(VR_RANDOM_DET, context);
+static void test_directed_ops(const test_directedTables &t, void *context) {
+  static const double operands[] = {1.,   0x1p-60, 0.1, -0.3,   1. / 3.,
+                                    3.,   -7.25,   1e10, 2.5e-3,
+                                    -0x1.fffffffffffffp-1};
+  for (double a : operands) {
+    for (double b : operands) {
+      const float af = (float)a;
+      const float bf = (float)b;
+      TEST_DIRECTED(add_double, double, a, b, a, b);
+      TEST_DIRECTED(add_float, float, a, b, af, bf);
+      TEST_DIRECTED(sub_double, double, a, b, a, b);
+      TEST_DIRECTED(sub_float, float, a, b, af, bf);
+      TEST_DIRECTED(mul_double, double, a, b, a, b);
+      TEST_DIRECTED(mul_float, float, a, b, af, bf);
+      TEST_DIRECTED(div_double, double, a, b, a, b);
+      TEST_DIRECTED(div_float, float, a, b, af, bf);
+      for (double c : operands) {
+        const float cf = (float)c;
+        TEST_DIRECTED(fma_double, double, a, b, a, b, c);
+        TEST_DIRECTED(fma_float, float, a, b, af, bf, cf);
+      }
+    }
+    TEST_DIRECTED(cast_double_to_float, float, a, 0., a);
+  }
+}
 
-  uint64_t seed = 0;
-  seed = 1020000002;
-  std::cout << "seed: " << seed << std::endl;
-  // seed=1000000000;
-  //  if(conf.seed==(unsigned int) -1){
-  //    struct timeval t1;
-  //    gettimeofday(&t1, NULL);
-  //    conf.seed =  t1.tv_usec + getpid();
-  //  }
-  verrou_set_seed(seed);
+static void test_hardware_rounding(void *context) {
+  static const enum vr_RoundingMode modes[] = {VR_UPWARD, VR_DOWNWARD,
+                                               VR_ZERO};
+  for (enum vr_RoundingMode mode : modes) {
+    test_directedTables t;
+    t.mode = mode;
+    t.nearest = test_backend(context, VR_NEAREST, 0, NULL, NULL);
+    t.emulated = test_backend(context, mode, 0, NULL, NULL);
+    t.hardware = test_backend(context, mode, 1, NULL, NULL);
+#if defined(__x86_64__)
+    const bool avx512 = vr_hardwareEmbeddedRounding;
+    if (avx512) {
+      t.path = "AVX-512F";
+      test_directed_ops(t, context);
+    } else {
+      std::cout << "no AVX-512F: only the software fallback of "
+                << verrou_rounding_mode_name(mode) << " is checked"
+                << std::endl;
+    }
+    vr_hardwareEmbeddedRounding = false;
+    t.path = "software fallback";
+    test_directed_ops(t, context);
+    vr_hardwareEmbeddedRounding = avx512;
+#else
+    t.path = "emulated";
+    test_directed_ops(t, context);
+#endif
+  }
+}
 
-  verrou_set_debug_print_op(&print_debug);
+// * --instr-windows
 
-  double step = 0.1;
-  double acc = 0.;
+// in upward, 1 + 2^-60 is 1 outside the windows ('n') and 1 + ulp inside
+// ('p'); the op indices are counted per thread, from 0 in a new one
+static void test_windows_run(struct interflop_backend_interface_t backend,
+                             void *context, char *got, size_t nb) {
+  for (size_t i = 0; i < nb; i++) {
+    double res;
+    backend.interflop_add_double(1., 0x1p-60, &res, context);
+    got[i] = (res == 1.) ? 'n' : 'p';
+  }
+  got[nb] = '\0';
+}
 
-  for (int i = 0; i < 10000; i++) {
-    interflop_verrou_add_double(acc, step, &acc, context);
+static void test_windows_case(void *context, const char *spec,
+                              const char *expected) {
+  struct interflop_backend_interface_t backend =
+      test_backend(context, VR_UPWARD, 0, spec, NULL);
+  char got[64];
+  std::thread thread(test_windows_run, backend, context, got,
+                     strlen(expected));
+  thread.join();
+  TEST_CHECK(strcmp(got, expected) == 0, "--instr-windows=%s: %s instead of %s",
+             spec, got, expected);
+}
+
+static void test_instr_windows(void *context) {
+  test_windows_case(context, "2-4", "nnppnnnnnn");
+  test_windows_case(context, "2-4,6-", "nnppnnpppp");
+  test_windows_case(context, "0-1,3-5,8-9", "pnnppnnnpn");
+  test_windows_case(context, "1/2", "pnpnpnpn");
+  test_windows_case(context, "2/3:1", "nnppnnnnppnn");
+
+  static const char *invalid[] = {"",    "-3",      "4-2",   "2-2",
+                                  "1-3,2-5", "1-2x", "1-2,",  "2/0",
+                                  "0/3", "2/3:3",   "2/3:",  "a-b"};
+  for (const char *spec : invalid) {
+    TEST_CHECK(test_rejected(context, spec, NULL),
+               "--instr-windows=%s is not rejected", spec);
   }
-  std::cout << std::setprecision(16);
-  std::cout << "acc: " << acc << std::endl;
+}
 
-  interflop_verrou_finalize(context);
+// * --instr-ops
+
+// in upward, whether each op is perturbed: its result is not the nearest one
+static void test_ops_case(void *context, const char *spec,
+                          const char *expected) {
+  struct interflop_backend_interface_t backend =
+      test_backend(context, VR_UPWARD, 0, NULL, spec);
+  double d;
+  float f;
+  char got[16];
+  size_t i = 0;
+  backend.interflop_add_double(1., 0x1p-60, &d, context);
+  got[i++] = (d != 1.) ? 'p' : 'n';
+  backend.interflop_add_float(1.f, 0x1p-30f, &f, context);
+  got[i++] = (f != 1.f) ? 'p' : 'n';
+  backend.interflop_sub_double(1., -0x1p-60, &d, context);
+  got[i++] = (d != 1.) ? 'p' : 'n';
+  backend.interflop_sub_float(1.f, -0x1p-30f, &f, context);
+  got[i++] = (f != 1.f) ? 'p' : 'n';
+  backend.interflop_mul_double(1. + 0x1p-52, 1. + 0x1p-52, &d, context);
+  got[i++] = (d != 1. + 0x1p-51) ? 'p' : 'n';
+  backend.interflop_mul_float(1.f + 0x1p-23f, 1.f + 0x1p-23f, &f, context);
+  got[i++] = (f != 1.f + 0x1p-22f) ? 'p' : 'n';
+  backend.interflop_div_double(1., 3., &d, context);
+  got[i++] = (d != 0x1.5555555555555p-2) ? 'p' : 'n';
+  backend.interflop_div_float(5.f, 3.f, &f, context);
+  got[i++] = (f != 0x1.aaaaaap+0f) ? 'p' : 'n';
+  backend.interflop_fma_double(1., 1., 0x1p-60, &d, context);
+  got[i++] = (d != 1.) ? 'p' : 'n';
+  backend.interflop_fma_float(1.f, 1.f, 0x1p-30f, &f, context);
+  got[i++] = (f != 1.f) ? 'p' : 'n';
+  backend.interflop_cast_double_to_float(1. + 0x1p-40, &f, context);
+  got[i++] = (f != 1.f) ? 'p' : 'n';
+  got[i] = '\0';
+  TEST_CHECK(strcmp(got, expected) == 0, "--instr-ops=%s: %s instead of %s",
+             spec, got, expected);
+}
+
+static void test_instr_ops(void *context) {
+  // add_double add_float sub_double sub_float mul_double mul_float
+  // div_double div_float fma_double fma_float cast
+  test_ops_case(context, NULL, "ppppppppppp");
+  test_ops_case(context, "add_double,mul", "pnnnppnnnnn");
+  test_ops_case(context, "cast,fma_float", "nnnnnnnnnpp");
+  test_ops_case(context, "SUB_Float,div", "nnnpnnppnnn");
+  test_ops_case(context, "add,sub,mul,div,fma,cast", "ppppppppppp");
 
-  return 0;
+  static const char *invalid[] = {"",          "pow",          "add_int",
+                                  "cast_double", "add,",       ",add",
+                                  "add_double_float", "add_doublexxxxxxxx"};
+  for (const char *spec : invalid) {
+    TEST_CHECK(test_rejected(context, NULL, spec),
+               "--instr-ops=%s is not rejected", spec);
+  }
+}
+
+int main() {
+  test_set_handlers();
+  void *context;
+  interflop_verrou_pre_init((File *)stderr, test_panic, &context);
+
+  test_random_det(context);
+  test_hardware_rounding(context);
+  test_instr_windows(context);
+  test_instr_ops(context);
+
+  interflop_verrou_finalize(context);
+  std::cout << nbFailure << " failed checks" << std::endl;
+  return nbFailure == 0 ? 0 : 1;
 }
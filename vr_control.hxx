@@ -0,0 +1,64 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Shared memory control and telemetry block.                   ---*/
+/*---                                               vr_control.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+#include "interflop_verrou.h"
+
+// number of ops between two safe points
+#define VR_CONTROL_PERIOD 65536
+
+extern verrou_control_t *vr_control;
+
+// op counters are kept private to each thread and only added to the control
+// block at safe points
+typedef struct {
+  uint64_t opCount[VERROU_CONTROL_NB_OP];
+  uint32_t countdown;
+  uint32_t exitFlush; // the counts are flushed when the thread exits
+} vr_controlThread_t;
+
+extern __thread vr_controlThread_t vr_controlThread
+    __attribute__((tls_model("initial-exec")));
+
+inline void vr_control_tick(uint64_t opHash, void *context) {
+  vr_controlThread.opCount[opHash]++;
+  // the countdown starts at 0 in new threads: they sync on their first op
+  if (__builtin_expect(vr_controlThread.countdown-- <= 1, 0)) {
+    verrou_control_sync(context);
+  }
+}
+
+// bulk counterpart of vr_control_tick for the array and reduction kernels,
+// which synchronize on entry
+inline void vr_control_count(uint64_t opHash, uint64_t nb) {
+  vr_controlThread.opCount[opHash] += nb;
+}
@@ -33,6 +33,7 @@
 #pragma once
 
 #include <cfloat>
+#include <limits>
 #include <stdint.h>
 
 #include "interflop-stdlib/interflop_stdlib.h"
@@ -89,3 +90,25 @@ template <> inline bool isNanInf<float>(const float &x) {
   const uint32_t *X = reinterpret_cast<const uint32_t *>(&x);
   return (*X & mask) == mask;
 }
+
+/*
+ * unbiased exponent read from the bit pattern, zero and subnormals get the
+ * minimal value: cheap enough to be used on every op by the event counters
+ */
+template <class REALTYPE> inline int vr_exponent(const REALTYPE &x);
+
+template <> inline int vr_exponent<double>(const double &x) {
+  uint64_t u;
+  __builtin_memcpy(&u, &x, sizeof(u));
+  return (int)((u >> 52) & 0x7ff) - 1023;
+}
+
+template <> inline int vr_exponent<float>(const float &x) {
+  uint32_t u;
+  __builtin_memcpy(&u, &x, sizeof(u));
+  return (int)((u >> 23) & 0xff) - 127;
+}
+
+template <class REALTYPE> inline bool isSubnormal(const REALTYPE &x) {
+  return x != 0 && __builtin_fabs(x) < std::numeric_limits<REALTYPE>::min();
+}
@@ -0,0 +1,112 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Op kernels under stable names.                               ---*/
+/*---                                               vr_kernels.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+#include "interflop_verrou.h"
+#include "static_backends.hxx"
+
+// The kernels are bound to a rounding mode when the application is
+// instrumented, and to the NaN/Inf policy of the static tables in the default
+// mode (get_static_backend): they never call the handlers, and --naninf=count
+// only applies through the backend tables.
+typedef vr_nanInfIgnore vr_kernelNanInf;
+
+// the body of the op is inlined in each clone of the exported kernel itself,
+// instead of calling the kernel of the static backend table
+typedef CastOp<double, float> vr_kernelCast;
+#define VR_KERNEL_APPLY(ROUNDING, RAND, OP, ...)                               \
+  StaticRounding<ROUNDING, RAND, vr_kernelNanInf>::apply<OP>(                  \
+      OP::PackArgs(__VA_ARGS__), vr_contextRand(context))
+
+#define VR_KERNEL_DEFINE(MODE, ROUNDING, RAND)                                 \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_add_double)(            \
+      double a, double b, double *res, void *context) {                        \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, AddOp<double>, a, b);               \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_add_float)(             \
+      float a, float b, float *res, void *context) {                           \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, AddOp<float>, a, b);                \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_sub_double)(            \
+      double a, double b, double *res, void *context) {                        \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, SubOp<double>, a, b);               \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_sub_float)(             \
+      float a, float b, float *res, void *context) {                           \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, SubOp<float>, a, b);                \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_mul_double)(            \
+      double a, double b, double *res, void *context) {                        \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, MulOp<double>, a, b);               \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_mul_float)(             \
+      float a, float b, float *res, void *context) {                           \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, MulOp<float>, a, b);                \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_div_double)(            \
+      double a, double b, double *res, void *context) {                        \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, DivOp<double>, a, b);               \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_div_float)(             \
+      float a, float b, float *res, void *context) {                           \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, DivOp<float>, a, b);                \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_cast_double_to_float)(  \
+      double a, float *res, void *context) {                                   \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, vr_kernelCast, a);                  \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_fma_double)(            \
+      double a, double b, double c, double *res, void *context) {              \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, MAddOp<double>, a, b, c);           \
+  }                                                                            \
+  VR_MULTIARCH_KERNEL void INTERFLOP_VERROU_API(MODE##_fma_float)(             \
+      float a, float b, float c, float *res, void *context) {                  \
+    *res = VR_KERNEL_APPLY(ROUNDING, RAND, MAddOp<float>, a, b, c);            \
+  }
+
+// same mapping as get_static_backend, but the prng modes dispatch on the
+// engine of the generator and the directed modes ignore --hardware-rounding
+VR_KERNEL_DEFINE(nearest, RoundingNearest, Void)
+VR_KERNEL_DEFINE(upward, RoundingUpward, Void)
+VR_KERNEL_DEFINE(downward, RoundingDownward, Void)
+VR_KERNEL_DEFINE(zero, RoundingZero, Void)
+VR_KERNEL_DEFINE(random, RoundingRandom, vr_rand_prng)
+VR_KERNEL_DEFINE(random_det, RoundingRandom, vr_rand_det)
+VR_KERNEL_DEFINE(random_comdet, RoundingRandom, vr_rand_comdet)
+VR_KERNEL_DEFINE(average, RoundingAverage, vr_rand_prng)
+VR_KERNEL_DEFINE(average_det, RoundingAverage, vr_rand_det)
+VR_KERNEL_DEFINE(average_comdet, RoundingAverage, vr_rand_comdet)
+VR_KERNEL_DEFINE(prandom, RoundingPRandom, vr_rand_prng)
+VR_KERNEL_DEFINE(prandom_det, RoundingPRandom, vr_rand_det)
+VR_KERNEL_DEFINE(prandom_comdet, RoundingPRandom, vr_rand_comdet)
+VR_KERNEL_DEFINE(farthest, RoundingFarthest, Void)
+VR_KERNEL_DEFINE(float, RoundingFloat, Void)
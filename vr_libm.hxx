@@ -0,0 +1,200 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- libm functions as ops.                                       ---*/
+/*---                                                 vr_libm.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+
+#pragma once
+
+#include <math.h>
+
+#include "interflop_verrou.h"
+#include "vr_op.hxx"
+
+/*
+ * A libm function as an op of vr_op.hxx, so that the rounding modes of
+ * vr_roundingOp.hxx apply to its result: nearestOp is the libm result and
+ * error its distance to the function evaluated in a wider type (long double
+ * for double, double for float). The libm result is only faithful, the
+ * rounding modes thus work from the exact result as known to the wider type.
+ */
+enum vr_libmHash : uint32_t {
+#define VR_LIBM_HASH(NAME) vr_libmHash_##NAME,
+  VERROU_LIBM_FUNCTIONS_1(VR_LIBM_HASH) VERROU_LIBM_FUNCTIONS_2(VR_LIBM_HASH)
+#undef VR_LIBM_HASH
+      vr_libmNbHash
+};
+
+/*
+ * The libm functions called by the backend, resolved in the libm itself
+ * (vr_libm_resolve): with libinterflop_verrou_libm preloaded, the symbols
+ * resolve to the interposer, which would apply the rounding mode a second
+ * time when the verrou_libm_* entry points are called directly.
+ */
+#define VR_LIBM_NATIVE_1(NAME)                                                 \
+  double (*NAME)(double);                                                      \
+  float (*NAME##f)(float);                                                     \
+  long double (*NAME##l)(long double);
+#define VR_LIBM_NATIVE_2(NAME)                                                 \
+  double (*NAME)(double, double);                                              \
+  float (*NAME##f)(float, float);                                              \
+  long double (*NAME##l)(long double, long double);
+struct vr_libmNative_t {
+  VERROU_LIBM_FUNCTIONS_1(VR_LIBM_NATIVE_1)
+  VERROU_LIBM_FUNCTIONS_2(VR_LIBM_NATIVE_2)
+};
+
+extern vr_libmNative_t vr_libmNative;
+extern bool vr_libmNativeReady;
+extern "C" void vr_libm_resolve(void) __attribute__((cold));
+
+inline const vr_libmNative_t &vr_libm_native() {
+  if (__builtin_expect(
+          !__atomic_load_n(&vr_libmNativeReady, __ATOMIC_ACQUIRE), 0)) {
+    vr_libm_resolve();
+  }
+  return vr_libmNative;
+}
+
+// FUNC::name, FUNC::hash, FUNC::apply (float and double) and FUNC::wide
+#define VR_LIBM_FUNCTION_1(NAME)                                               \
+  struct vr_libm_##NAME {                                                      \
+    static const char *name() { return #NAME; }                                \
+    static const uint32_t hash = vr_libmHash_##NAME;                           \
+    static inline double apply(double x) { return vr_libm_native().NAME(x); }  \
+    static inline float apply(float x) { return vr_libm_native().NAME##f(x); } \
+    static inline long double wide(double x) {                                 \
+      return vr_libm_native().NAME##l(x);                                      \
+    }                                                                          \
+    static inline double wide(float x) {                                       \
+      return vr_libm_native().NAME((double)x);                                 \
+    }                                                                          \
+  };
+#define VR_LIBM_FUNCTION_2(NAME)                                               \
+  struct vr_libm_##NAME {                                                      \
+    static const char *name() { return #NAME; }                                \
+    static const uint32_t hash = vr_libmHash_##NAME;                           \
+    static inline double apply(double x, double y) {                           \
+      return vr_libm_native().NAME(x, y);                                      \
+    }                                                                          \
+    static inline float apply(float x, float y) {                              \
+      return vr_libm_native().NAME##f(x, y);                                   \
+    }                                                                          \
+    static inline long double wide(double x, double y) {                       \
+      return vr_libm_native().NAME##l(x, y);                                   \
+    }                                                                          \
+    static inline double wide(float x, float y) {                              \
+      return vr_libm_native().NAME((double)x, (double)y);                      \
+    }                                                                          \
+  };
+VERROU_LIBM_FUNCTIONS_1(VR_LIBM_FUNCTION_1)
+VERROU_LIBM_FUNCTIONS_2(VR_LIBM_FUNCTION_2)
+
+template <class FUNC, typename REAL, int NB> class LibmOp {
+public:
+  typedef REAL RealType;
+  typedef vr_packArg<RealType, NB> PackArgs;
+
+  static const char *OpName() { return FUNC::name(); }
+  // after the hashes of the arithmetic ops, for the det modes
+  static inline uint64_t getHash() {
+    return (opHash::nbOpHash + FUNC::hash) * typeHash::nbTypeHash +
+           getTypeHash<RealType>();
+  }
+
+  static inline RealType nearestOp(const vr_packArg<RealType, 1> &p) {
+    return FUNC::apply(p.arg1);
+  }
+  static inline RealType nearestOp(const vr_packArg<RealType, 2> &p) {
+    return FUNC::apply(p.arg1, p.arg2);
+  }
+
+  static inline RealType error(const vr_packArg<RealType, 1> &p,
+                               const RealType &x) {
+    return errorOf(p, FUNC::wide(p.arg1), x);
+  }
+  static inline RealType error(const vr_packArg<RealType, 2> &p,
+                               const RealType &x) {
+    return errorOf(p, FUNC::wide(p.arg1, p.arg2), x);
+  }
+
+  /*
+   * Whether x may be exact: the exact results of these functions are short
+   * numbers (exp(0), cbrt(8), hypot(3,4), pow(2,3)) or one of the arguments
+   * (pow(x,1), hypot(x,0)), while an inexact result ends with half a mantissa
+   * of zero bits once in 2^26 (double) or 2^12 (float) only.
+   */
+  static inline bool mayBeExact(__attribute__((unused))
+                                const vr_packArg<RealType, 1> &p,
+                                const RealType &x) {
+    typedef typename std::conditional<sizeof(RealType) == sizeof(uint64_t),
+                                      uint64_t, uint32_t>::type UintType;
+    const int half = (std::numeric_limits<RealType>::digits - 1) / 2;
+    UintType u;
+    __builtin_memcpy(&u, &x, sizeof(u));
+    return (u & (((UintType)1 << half) - 1)) == 0;
+  }
+  static inline bool mayBeExact(const vr_packArg<RealType, 2> &p,
+                                const RealType &x) {
+    return mayBeExact(vr_packArg<RealType, 1>(p.arg1), x) ||
+           __builtin_fabs(x) == __builtin_fabs(p.arg1) ||
+           __builtin_fabs(x) == __builtin_fabs(p.arg2);
+  }
+
+  static inline RealType sameSignOfError(const PackArgs &p, const RealType &c) {
+    return error(p, c);
+  }
+
+  // none of the functions is commutative in general (hypot aside)
+  static inline const PackArgs comdetPack(const PackArgs &p) { return p; }
+  static inline uint64_t getComdetHash() { return getHash(); }
+
+  static inline bool isInfNotSpecificToNearest(const PackArgs &p) {
+    return p.isOneArgNanInf();
+  }
+
+  static inline void check(__attribute__((unused)) const PackArgs &p,
+                           __attribute__((unused)) const RealType &c) {}
+
+private:
+  // the wider evaluation is only faithful (cbrt(27.) is 3 plus an ulp in
+  // glibc): a result which may be exact is taken as exact within an ulp of
+  // the wider type
+  template <class WIDE>
+  static inline RealType errorOf(const PackArgs &p, const WIDE &wide,
+                                 const RealType &x) {
+    const WIDE e = wide - (WIDE)x;
+    const WIDE tolerance =
+        std::numeric_limits<WIDE>::epsilon() * (x < 0 ? -(WIDE)x : (WIDE)x);
+    if ((e <= tolerance && -e <= tolerance) && mayBeExact(p, x)) {
+      return 0;
+    }
+    return (RealType)e;
+  }
+};
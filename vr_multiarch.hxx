@@ -0,0 +1,70 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Runtime selection of ISA specific kernels.                   ---*/
+/*---                                            vr_multiarch.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+/*
+ * With VERROU_MULTIARCH (default on x86_64, see --enable-verrou-multiarch)
+ * the library is built for baseline x86-64 and every op kernel exposed in a
+ * backend table is cloned for x86-64-v3 (AVX2+FMA) and x86-64-v4
+ * (AVX-512). The dynamic loader picks the best clone through an ifunc
+ * resolver, so one binary runs at full speed on heterogeneous nodes.
+ */
+#if defined(VERROU_MULTIARCH) && defined(__x86_64__) && defined(__GNUC__) &&  \
+    !defined(__clang__)
+#define VR_MULTIARCH_KERNEL                                                    \
+  __attribute__((target_clones("default", "arch=x86-64-v3",                   \
+                               "arch=x86-64-v4"),                             \
+                 flatten))
+#define VR_RUNTIME_FMA
+#else
+#define VR_MULTIARCH_KERNEL
+#endif
+
+#ifdef VR_RUNTIME_FMA
+// set from CPUID in interflop_verrou_init
+extern bool vr_hardwareFma;
+
+/*
+ * Hardware FMA, usable from every clone: the baseline clone is compiled
+ * without -mfma, so the instruction is emitted through inline asm and only
+ * executed when CPUID reported FMA support.
+ */
+inline double vr_hardware_fma(double a, double b, double c) {
+  __asm__("vfmadd231sd %2, %1, %0" : "+x"(c) : "x"(a), "x"(b));
+  return c;
+}
+
+inline float vr_hardware_fma(float a, float b, float c) {
+  __asm__("vfmadd231ss %2, %1, %0" : "+x"(c) : "x"(a), "x"(b));
+  return c;
+}
+#endif
@@ -83,3 +83,70 @@ template <class REALTYPE> inline REALTYPE nextPrev(REALTYPE a) {
          : (a != 0) ? nextAwayFromZero(a)
                     : -std::numeric_limits<REALTYPE>::denorm_min();
 };
+
+/*
+ * up ? nextAfter(a) : nextPrev(a) without branch, for the kernels where the
+ * direction is random and a branch on it is mispredicted half of the time
+ */
+template <class REALTYPE> inline REALTYPE nextUlp(REALTYPE a, bool up) {
+  return up ? nextAfter(a) : nextPrev(a);
+};
+
+template <> inline double nextUlp<double>(double a, bool up) {
+  uint64_t u;
+  __builtin_memcpy(&u, &a, sizeof(u));
+  // masks rather than bools, which the compiler turns back into branches
+  const uint64_t upMask = -(uint64_t)up;
+  const uint64_t awayMask =
+      (upMask & -(uint64_t)(a >= 0)) | (~upMask & -(uint64_t)(a < 0));
+  const uint64_t zeroMask = ~upMask & -(uint64_t)(a == 0);
+  const uint64_t moved = u + (awayMask & 2) - 1;
+  const uint64_t resU =
+      (moved & ~zeroMask) | (0x8000000000000001ULL & zeroMask);
+  double res;
+  __builtin_memcpy(&res, &resU, sizeof(res));
+  return res;
+};
+
+template <> inline float nextUlp<float>(float a, bool up) {
+  uint32_t u;
+  __builtin_memcpy(&u, &a, sizeof(u));
+  // masks rather than bools, which the compiler turns back into branches
+  const uint32_t upMask = -(uint32_t)up;
+  const uint32_t awayMask =
+      (upMask & -(uint32_t)(a >= 0)) | (~upMask & -(uint32_t)(a < 0));
+  const uint32_t zeroMask = ~upMask & -(uint32_t)(a == 0);
+  const uint32_t moved = u + (awayMask & 2) - 1;
+  const uint32_t resU = (moved & ~zeroMask) | (0x80000001U & zeroMask);
+  float res;
+  __builtin_memcpy(&res, &resU, sizeof(res));
+  return res;
+};
+
+// c ? a : b without branch, for the same kernels
+template <class REALTYPE>
+inline REALTYPE selectNoBranch(bool c, REALTYPE a, REALTYPE b) {
+  return c ? a : b;
+};
+
+template <> inline double selectNoBranch<double>(bool c, double a, double b) {
+  uint64_t aU, bU;
+  __builtin_memcpy(&aU, &a, sizeof(aU));
+  __builtin_memcpy(&bU, &b, sizeof(bU));
+  const uint64_t mask = -(uint64_t)c;
+  const uint64_t resU = (aU & mask) | (bU & ~mask);
+  double res;
+  __builtin_memcpy(&res, &resU, sizeof(res));
+  return res;
+};
+
+template <> inline float selectNoBranch<float>(bool c, float a, float b) {
+  uint32_t aU, bU;
+  __builtin_memcpy(&aU, &a, sizeof(aU));
+  __builtin_memcpy(&bU, &b, sizeof(bU));
+  const uint32_t mask = -(uint32_t)c;
+  const uint32_t resU = (aU & mask) | (bU & ~mask);
+  float res;
+  __builtin_memcpy(&res, &resU, sizeof(res));
+  return res;
+};
@@ -37,6 +37,7 @@
 
 #include "interflop-stdlib/fma/interflop_fma.h"
 #include "vr_isNan.hxx"
+#include "vr_multiarch.hxx"
 
 enum opHash : uint32_t {
   addHash = 0,
@@ -68,13 +69,31 @@ REAL __verrou_internal_fma(const REAL &a, const REAL &b, const REAL &c);
 
 template <>
 float __verrou_internal_fma(const float &a, const float &b, const float &c) {
+#if defined(__FMA__)
+  return __builtin_fmaf(a, b, c);
+#else
+#ifdef VR_RUNTIME_FMA
+  if (vr_hardwareFma) {
+    return vr_hardware_fma(a, b, c);
+  }
+#endif
   return interflop_fma_binary32(a, b, c);
+#endif
 }
 
 template <>
 double __verrou_internal_fma(const double &a, const double &b,
                              const double &c) {
+#if defined(__FMA__)
+  return __builtin_fma(a, b, c);
+#else
+#ifdef VR_RUNTIME_FMA
+  if (vr_hardwareFma) {
+    return vr_hardware_fma(a, b, c);
+  }
+#endif
   return interflop_fma_binary64(a, b, c);
+#endif
 }
 template <>
 __float128 __verrou_internal_fma(const __float128 &a, const __float128 &b,
@@ -113,6 +132,8 @@ template <class REALTYPE> struct vr_packArg<REALTYPE, 1> {
 
   inline bool isOneArgNanInf() const { return isNanInf<RealType>(arg1); }
 
+  inline bool isOneArgSubnormal() const { return isSubnormal<RealType>(arg1); }
+
   const RealType &arg1;
 };
 
@@ -131,6 +152,10 @@ template <class REALTYPE> struct vr_packArg<REALTYPE, 2> {
     return (isNanInf<RealType>(arg1) || isNanInf<RealType>(arg2));
   }
 
+  inline bool isOneArgSubnormal() const {
+    return (isSubnormal<RealType>(arg1) || isSubnormal<RealType>(arg2));
+  }
+
   const RealType &arg1;
   const RealType &arg2;
 };
@@ -153,6 +178,11 @@ template <class REALTYPE> struct vr_packArg<REALTYPE, 3> {
             isNanInf<RealType>(arg3));
   }
 
+  inline bool isOneArgSubnormal() const {
+    return (isSubnormal<RealType>(arg1) || isSubnormal<RealType>(arg2) ||
+            isSubnormal<RealType>(arg3));
+  }
+
   const RealType &arg1;
   const RealType &arg2;
   const RealType &arg3;
@@ -230,6 +260,17 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &c) {}
 
+  // number of bits lost by cancellation, from the exponents
+  static inline int cancellation(const PackArgs &p, const RealType &c) {
+    return std::max(vr_exponent(p.arg1), vr_exponent(p.arg2)) -
+           vr_exponent(c);
+  }
+
+  // the result is equal to one operand, the other one being absorbed
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return (c == p.arg1 && p.arg2 != 0) || (c == p.arg2 && p.arg1 != 0);
+  }
+
   static inline void twoSum(const RealType &a, const RealType &b, RealType &x,
                             RealType &y) {
     const PackArgs p(a, b);
@@ -277,6 +318,15 @@ public:
   }
 
   static inline void check(const PackArgs &p, const RealType &c) {}
+
+  static inline int cancellation(const PackArgs &p, const RealType &c) {
+    return std::max(vr_exponent(p.arg1), vr_exponent(p.arg2)) -
+           vr_exponent(c);
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return (c == p.arg1 && p.arg2 != 0) || (c == -p.arg2 && p.arg1 != 0);
+  }
 };
 
 // splitFactor used by MulOp
@@ -348,6 +398,16 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &c){};
 
+  static inline int cancellation(__attribute__((unused)) const PackArgs &p,
+                                 __attribute__((unused)) const RealType &c) {
+    return 0;
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return (c == p.arg1 && p.arg1 != 0 && p.arg2 != 1) ||
+           (c == p.arg2 && p.arg2 != 0 && p.arg1 != 1);
+  }
+
   static inline void twoProd(const RealType &a, const RealType &b, RealType &x,
                              RealType &y) {
     const PackArgs p(a, b);
@@ -373,10 +433,15 @@ public:
   };
 
   static inline RealType error(const PackArgs &p, const RealType &x) {
+#ifndef VERROU_FLOAT_EFT
+    // exact: the product of two floats fits in 48 bits
+    return (float)((double)p.arg1 * (double)p.arg2 - (double)x);
+#else
     /*Provient de "Accurate Sum and dot product" OGITA RUMP OISHI */
     const RealType a(p.arg1);
     const RealType b(p.arg2);
     return __verrou_internal_fma(a, b, -x);
+#endif
   };
 
   static inline void split(RealType a, RealType &x, RealType &y) {
@@ -388,8 +453,12 @@ public:
   }
 
   static inline RealType sameSignOfError(const PackArgs &p, const RealType &c) {
+#ifndef VERROU_FLOAT_EFT
+    const double res = (double)p.arg1 * (double)p.arg2 - (double)c;
+#else
     double res = MulOp<double>::error(
         vr_packArg<double, 2>((double)p.arg1, (double)p.arg2), (double)c);
+#endif
     if (res < 0) {
       return -1;
     }
@@ -410,6 +479,16 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &c){};
 
+  static inline int cancellation(__attribute__((unused)) const PackArgs &p,
+                                 __attribute__((unused)) const RealType &c) {
+    return 0;
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return (c == p.arg1 && p.arg1 != 0 && p.arg2 != 1) ||
+           (c == p.arg2 && p.arg2 != 0 && p.arg1 != 1);
+  }
+
   static inline void twoProd(const RealType &a, const RealType &b, RealType &x,
                              RealType &y) {
     const PackArgs p(a, b);
@@ -437,13 +516,21 @@ public:
   static inline RealType error(const PackArgs &p, const RealType &c) {
     const RealType &x(p.arg1);
     const RealType &y(p.arg2);
-    return -__verrou_internal_fma(c, y, -x);
+    return -__verrou_internal_fma(c, y, -x) / y;
   };
 
   static inline RealType sameSignOfError(const PackArgs &p, const RealType &c) {
+    // the error is the remainder divided by y: its sign depends on y too
     const RealType &x(p.arg1);
     const RealType &y(p.arg2);
-    return -__verrou_internal_fma(c, y, -x);
+    const RealType r = -__verrou_internal_fma(c, y, -x);
+    if (r > 0) {
+      return y;
+    } else if (r < 0) {
+      return -y;
+    } else {
+      return 0.0;
+    }
   };
 
   static inline const PackArgs comdetPack(const PackArgs &p) { return p; }
@@ -451,6 +538,15 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &c){};
 
+  static inline int cancellation(__attribute__((unused)) const PackArgs &p,
+                                 __attribute__((unused)) const RealType &c) {
+    return 0;
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return c == p.arg1 && p.arg1 != 0 && p.arg2 != 1;
+  }
+
   static inline bool isInfNotSpecificToNearest(const PackArgs &p) {
     return (isNanInf<RealType>(p.arg1)) || (p.arg2 == RealType(0.));
   }
@@ -473,15 +569,22 @@ public:
   };
 
   static inline RealType error(const PackArgs &p, const RealType &c) {
+#ifndef VERROU_FLOAT_EFT
+    // c*y and the remainder x-c*y are exact in double (no fma needed), the
+    // quotient is rounded once
+    const double y((double)p.arg2);
+    return (float)(((double)p.arg1 - (double)c * y) / y);
+#else
     const RealType &x(p.arg1);
     const RealType &y(p.arg2);
     return -__verrou_internal_fma(c, y, -x) / y;
+#endif
   };
 
   static inline RealType sameSignOfError(const PackArgs &p, const RealType &c) {
     const double x((double)p.arg1);
     const double y((double)p.arg2);
-    const double r = -__verrou_internal_fma((double)c, y, -x);
+    const double r = x - (double)c * y;
     if (r > 0) {
       return p.arg2;
     } else if (r < 0) {
@@ -496,11 +599,60 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &c){};
 
+  static inline int cancellation(__attribute__((unused)) const PackArgs &p,
+                                 __attribute__((unused)) const RealType &c) {
+    return 0;
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &c) {
+    return c == p.arg1 && p.arg1 != 0 && p.arg2 != 1;
+  }
+
   static inline bool isInfNotSpecificToNearest(const PackArgs &p) {
     return (isNanInf<RealType>(p.arg1)) || (p.arg2 == RealType(0.));
   }
 };
 
+/*
+ * As MulOp<float> and DivOp<float>, the float fma reads its error from the
+ * evaluation in double, where the product of two floats is exact, instead of
+ * running the float error-free transforms (kept with VERROU_FLOAT_EFT). The
+ * float sum and difference keep TwoSum: the conversions cost more than the
+ * transform itself.
+ */
+template <class REAL>
+inline REAL vr_maddError(const REAL &a, const REAL &x, const REAL &b,
+                         const REAL &z) {
+  // ErrFmaApp : Exact and Aproximated Error of the FMA By Boldo and Muller
+  REAL ph, pl;
+  MulOp<REAL>::twoProd(a, x, ph, pl);
+
+  REAL uh, ul;
+  AddOp<REAL>::twoSum(b, ph, uh, ul);
+
+  const REAL t(uh - z);
+  return (t + (pl + ul));
+}
+
+#ifndef VERROU_FLOAT_EFT
+template <>
+inline float vr_maddError<float>(const float &a, const float &x,
+                                 const float &b, const float &z) {
+  // a*x is exact in double (no fma needed) and a*x+b rounded once: the sign
+  // is exact, and the error within 2^-29 ulp, unless the double rounding
+  // hides it
+  const double e = ((double)a * (double)x + (double)b) - (double)z;
+  if (__builtin_expect(e == 0., 0)) {
+    float ph, pl;
+    MulOp<float>::twoProd(a, x, ph, pl);
+    float uh, ul;
+    AddOp<float>::twoSum(b, ph, uh, ul);
+    return ((uh - z) + (pl + ul));
+  }
+  return (float)e;
+}
+#endif
+
 template <typename REAL> class MAddOp {
 public:
   typedef REAL RealType;
@@ -519,19 +671,7 @@ public:
   };
 
   static inline RealType error(const PackArgs &p, const RealType &z) {
-    // ErrFmaApp : Exact and Aproximated Error of the FMA By Boldo and Muller
-    const RealType &a(p.arg1);
-    const RealType &x(p.arg2);
-    const RealType &b(p.arg3);
-
-    RealType ph, pl;
-    MulOp<RealType>::twoProd(a, x, ph, pl);
-
-    RealType uh, ul;
-    AddOp<RealType>::twoSum(b, ph, uh, ul);
-
-    const RealType t(uh - z);
-    return (t + (pl + ul));
+    return vr_maddError<RealType>(p.arg1, p.arg2, p.arg3, z);
   };
 
   static inline RealType sameSignOfError(const PackArgs &p, const RealType &c) {
@@ -545,6 +685,17 @@ public:
 
   static inline void check(const PackArgs &p, const RealType &d){};
 
+  // cancellation between the product and the addend
+  static inline int cancellation(const PackArgs &p, const RealType &d) {
+    return std::max(vr_exponent(p.arg1) + vr_exponent(p.arg2),
+                    vr_exponent(p.arg3)) -
+           vr_exponent(d);
+  }
+
+  static inline bool isAbsorption(const PackArgs &p, const RealType &d) {
+    return d == p.arg3 && p.arg1 != 0 && p.arg2 != 0;
+  }
+
   static inline bool isInfNotSpecificToNearest(const PackArgs &p) {
     return p.isOneArgNanInf();
   }
@@ -586,4 +737,15 @@ public:
   }
 
   static inline void check(const PackArgs &p, const RealTypeOut &d){};
+
+  static inline int cancellation(__attribute__((unused)) const PackArgs &p,
+                                 __attribute__((unused)) const RealTypeOut &d) {
+    return 0;
+  }
+
+  static inline bool
+  isAbsorption(__attribute__((unused)) const PackArgs &p,
+               __attribute__((unused)) const RealTypeOut &d) {
+    return false;
+  }
 };
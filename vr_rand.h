@@ -32,22 +32,42 @@
 #ifndef __VR_RAND_H
 #define __VR_RAND_H
 
+#include <cstddef>
 #include <cstdint>
 
 #include "interflop-stdlib/prng/tinymt64.h"
 #include "interflop-stdlib/prng/xoshiro.hxx"
+#include "interflop_verrou.h"
 
+// random words drawn in bulk for the reduction kernels (vr_reduction.hxx)
+#define VR_RAND_BLOCK_NB_WORDS 64
+typedef struct Vr_RandBlock_ Vr_RandBlock;
+struct Vr_RandBlock_ {
+  uint64_t words_[VR_RAND_BLOCK_NB_WORDS];
+  uint32_t pos_;
+};
+
+/*
+ * Everything drawn by the ops of a context (verrou_context_t::rand): the
+ * process generator vr_rand, or the own one of a thread context.
+ */
 typedef struct Vr_Rand_ Vr_Rand;
 struct Vr_Rand_ {
-  tinymt64_t gen_;
-#ifdef USE_XOSHIRO
-  xoshiro128_state_t rng128_;
-  xoshiro256_state_t rng256_;
-#endif
+  // state of engine_ only (see the vr_randEngine* classes)
+  union {
+    tinymt64_t tinymt64_;
+    xoshiro256_state_t xoshiro256_;
+    uint64_t sfc64_[4];
+    uint64_t wyrand_;
+  } state_;
+  enum vr_RandEngine engine_;
   uint64_t current_;
   uint64_t seed_;
+  uint64_t hashKey_;
+  uint64_t hashMul_[8]; // multipliers of vr_multiply_shift_hash
   double p;
   uint32_t count_;
+  Vr_RandBlock block_;
 };
 
 // extern Vr_Rand vr_rand;
@@ -32,52 +32,242 @@
 // Warning FILE include in vr_rand.h
 #include "vr_rand.h"
 
-#ifndef USE_XOSHIRO
 #include "interflop-stdlib/prng/tinymt64.h"
-#else
 #include "interflop-stdlib/prng/xoshiro.hxx"
-#endif
 
 inline uint64_t vr_rand_getSeed(const Vr_Rand *r);
 
+/*
+ * splitmix64 finalizer: turns the seed into the key mixed in by the det
+ * hashes at use time, so that reseeding never regenerates hash tables
+ */
+inline uint64_t vr_rand_mix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
 #include "dietzfelbingerHash.hxx"
 #include "mersenneHash.hxx"
 #include "multiplyShiftHash.hxx"
 #include "tableHash.hxx"
 
-inline static uint64_t vr_rand_next(Vr_Rand *r) {
-#ifndef USE_XOSHIRO
-  return tinymt64_generate_uint64(&(r->gen_));
+/*
+ * Engines of the prng modes (--random-engine): seed sets the state of the
+ * engine in r->state_, next draws 64 random bits and nextDouble a double in
+ * [0,1). The static backends are specialized for each engine, the other
+ * users of vr_rand go through vr_randEngineDynamic.
+ */
+class vr_randEngineTinymt64 {
+public:
+  static inline void seed(Vr_Rand *r, uint64_t seed) {
+    tinymt64_init(&r->state_.tinymt64_, seed);
+  }
+  static inline uint64_t next(Vr_Rand *r) {
+    return tinymt64_generate_uint64(&r->state_.tinymt64_);
+  }
+  static inline double nextDouble(Vr_Rand *r) {
+    return tinymt64_generate_double(&r->state_.tinymt64_);
+  }
+};
+
+class vr_randEngineXoshiro256 {
+public:
+  static inline void seed(Vr_Rand *r, uint64_t seed) {
+    init_xoshiro256_state(r->state_.xoshiro256_, seed);
+  }
+  static inline uint64_t next(Vr_Rand *r) {
+    return xoshiro256plus_next(r->state_.xoshiro256_);
+  }
+  static inline double nextDouble(Vr_Rand *r) {
+    return xoshiro_uint64_to_double(next(r));
+  }
+};
+
+// Small Fast Chaotic generator (PractRand)
+class vr_randEngineSfc64 {
+public:
+  static inline void seed(Vr_Rand *r, uint64_t seed) {
+    uint64_t *s = r->state_.sfc64_;
+    s[0] = s[1] = s[2] = seed;
+    s[3] = 1;
+    for (int i = 0; i < 12; i++) {
+      next(r);
+    }
+  }
+  static inline uint64_t next(Vr_Rand *r) {
+    uint64_t *s = r->state_.sfc64_;
+    const uint64_t res = s[0] + s[1] + s[3]++;
+    s[0] = s[1] ^ (s[1] >> 11);
+    s[1] = s[2] + (s[2] << 3);
+    s[2] = ((s[2] << 24) | (s[2] >> 40)) + res;
+    return res;
+  }
+  static inline double nextDouble(Vr_Rand *r) {
+    return (next(r) >> 11) * 0x1.0p-53;
+  }
+};
+
+class vr_randEngineWyrand {
+public:
+  static inline void seed(Vr_Rand *r, uint64_t seed) {
+    r->state_.wyrand_ = seed;
+  }
+  static inline uint64_t next(Vr_Rand *r) {
+    r->state_.wyrand_ += 0xa0761d6478bd642fULL;
+    const __uint128_t m = (__uint128_t)r->state_.wyrand_ *
+                          (r->state_.wyrand_ ^ 0xe7037ed1a0b428dbULL);
+    return (uint64_t)(m >> 64) ^ (uint64_t)m;
+  }
+  static inline double nextDouble(Vr_Rand *r) {
+    return (next(r) >> 11) * 0x1.0p-53;
+  }
+};
+
+// dispatch on r->engine_
+class vr_randEngineDynamic {
+public:
+  static inline void seed(Vr_Rand *r, uint64_t seed) {
+    switch (r->engine_) {
+    case VR_RAND_TINYMT64:
+      return vr_randEngineTinymt64::seed(r, seed);
+    case VR_RAND_XOSHIRO256:
+      return vr_randEngineXoshiro256::seed(r, seed);
+    case VR_RAND_SFC64:
+      return vr_randEngineSfc64::seed(r, seed);
+    case VR_RAND_WYRAND:
+      return vr_randEngineWyrand::seed(r, seed);
+    }
+  }
+  static inline uint64_t next(Vr_Rand *r) {
+    switch (r->engine_) {
+    case VR_RAND_TINYMT64:
+      return vr_randEngineTinymt64::next(r);
+    case VR_RAND_XOSHIRO256:
+      return vr_randEngineXoshiro256::next(r);
+    case VR_RAND_SFC64:
+      return vr_randEngineSfc64::next(r);
+    case VR_RAND_WYRAND:
+      return vr_randEngineWyrand::next(r);
+    }
+    return 0;
+  }
+  static inline double nextDouble(Vr_Rand *r) {
+    switch (r->engine_) {
+    case VR_RAND_TINYMT64:
+      return vr_randEngineTinymt64::nextDouble(r);
+    case VR_RAND_XOSHIRO256:
+      return vr_randEngineXoshiro256::nextDouble(r);
+    case VR_RAND_SFC64:
+      return vr_randEngineSfc64::nextDouble(r);
+    case VR_RAND_WYRAND:
+      return vr_randEngineWyrand::nextDouble(r);
+    }
+    return 0.;
+  }
+};
+
+#ifdef USE_XOSHIRO
+#define VR_RAND_ENGINE_DEFAULT VR_RAND_XOSHIRO256
 #else
-  return xoshiro256plus_next(r->rng256_);
+#define VR_RAND_ENGINE_DEFAULT VR_RAND_TINYMT64
 #endif
+
+template <class ENGINE = vr_randEngineDynamic>
+inline static uint64_t vr_rand_next(Vr_Rand *r) {
+  return ENGINE::next(r);
+}
+
+inline static double vr_rand_double(Vr_Rand *r) {
+  return vr_randEngineDynamic::nextDouble(r);
+}
+
+/*
+ * bulk generation for the array entry points: keeps the generator loop out
+ * of the (vectorizable) loop consuming the random bits
+ */
+template <class ENGINE>
+inline static void vr_rand_fillWith(Vr_Rand *r, uint64_t *words, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    words[i] = ENGINE::next(r);
+  }
+}
+
+inline static void vr_rand_fill(Vr_Rand *r, uint64_t *words, size_t n) {
+  switch (r->engine_) {
+  case VR_RAND_TINYMT64:
+    return vr_rand_fillWith<vr_randEngineTinymt64>(r, words, n);
+  case VR_RAND_XOSHIRO256:
+    return vr_rand_fillWith<vr_randEngineXoshiro256>(r, words, n);
+  case VR_RAND_SFC64:
+    return vr_rand_fillWith<vr_randEngineSfc64>(r, words, n);
+  case VR_RAND_WYRAND:
+    return vr_rand_fillWith<vr_randEngineWyrand>(r, words, n);
+  }
+}
+
+/*
+ * A block holds either 64*VR_RAND_BLOCK_NB_WORDS random bits or
+ * VR_RAND_BLOCK_NB_WORDS ratios: a rounding mode draws only one kind. The
+ * kernel refills it before a run of steps which cannot exhaust it, so that
+ * each draw is a plain load.
+ */
+inline static void vr_rand_block_refill(Vr_RandBlock *b, Vr_Rand *r) {
+  vr_rand_fill(r, b->words_, VR_RAND_BLOCK_NB_WORDS);
+  b->pos_ = 0;
+}
+
+inline static bool vr_rand_block_bool(Vr_RandBlock *b) {
+  const uint32_t pos = b->pos_++;
+  return (b->words_[pos / 64] >> (pos % 64)) & 1;
+}
+
+// ratio in [0,1) with the full precision of REALTYPE
+template <class REALTYPE> inline REALTYPE vr_rand_ratioOfWord(uint64_t w);
+
+template <> inline double vr_rand_ratioOfWord<double>(uint64_t w) {
+  return (w >> 11) * 0x1.0p-53;
+}
+
+template <> inline float vr_rand_ratioOfWord<float>(uint64_t w) {
+  return (w >> 40) * 0x1.0p-24f;
+}
+
+template <class REALTYPE> inline REALTYPE vr_rand_block_ratio(Vr_RandBlock *b) {
+  return vr_rand_ratioOfWord<REALTYPE>(b->words_[b->pos_++]);
 }
 
 inline static uint32_t vr_loop() { return 63; }
 
-inline void vr_rand_setSeed(Vr_Rand *r, int seed) {
+inline void vr_rand_setSeed(Vr_Rand *r, uint64_t seed) {
   r->count_ = 0;
   r->seed_ = seed;
 
-#ifndef USE_XOSHIRO
-  tinymt64_init(&(r->gen_), r->seed_);
-#else
-  init_xoshiro128_state(r->rng128_, r->seed_);
-  init_xoshiro256_state(r->rng256_, r->seed_);
-#endif
+  vr_randEngineDynamic::seed(r, r->seed_);
   r->current_ = vr_rand_next(r);
-  vr_tabulation_hash::genTable((r->gen_));
-  //  vr_twisted_tabulation_hash::genTable((r->gen_));
-  vr_multiply_shift_hash::genTable((r->gen_));
-  const double p = tinymt64_generate_double(&(r->gen_));
-  r->p = p;
+  // Only the configured det hash is rekeyed: the tables it may need are
+  // seed independent and generated lazily on first det-mode use.
+  r->hashKey_ = vr_rand_mix64(r->seed_);
+#ifdef VERROU_DET_HASH
+  VERROU_DET_HASH::setKey(r);
+#endif
+  r->p = vr_rand_double(r);
 }
 
 inline uint64_t vr_rand_getSeed(const Vr_Rand *r) { return r->seed_; }
 
+// the state of the previous engine is replaced by the one of engine, seeded
+// with the same seed
+inline void vr_rand_setEngine(Vr_Rand *r, enum vr_RandEngine engine) {
+  r->engine_ = engine;
+  vr_rand_setSeed(r, r->seed_);
+}
+
+template <class ENGINE = vr_randEngineDynamic>
 inline bool vr_rand_bool(Vr_Rand *r) {
   if (r->count_ == vr_loop()) {
-    r->current_ = vr_rand_next(r);
+    r->current_ = vr_rand_next<ENGINE>(r);
     r->count_ = 0;
   }
   bool res = (r->current_ >> (r->count_++)) & 1;
@@ -117,25 +307,15 @@ constexpr double maxAvgInv(1 / 4294967296.);
 #error 'VERROU_NUM_AVG is not defined'
 #endif
 
-template <class REALTYPE> inline REALTYPE vr_rand_ratio(Vr_Rand *r);
-
-template <> inline double vr_rand_ratio<double>(Vr_Rand *r) {
+// the float ratio is the double one rounded to float
+template <class REALTYPE, class ENGINE = vr_randEngineDynamic>
+inline REALTYPE vr_rand_ratio(Vr_Rand *r) {
 #if VERROU_NUM_AVG == 1
-#ifndef USE_XOSHIRO
-  const double res = tinymt64_generate_double(&(r->gen_));
-#else
-  // const double res=xoshiro_uint32_to_float(xoshiro128plus_next(r->rng128_));
-  const double res =
-      xoshiro_uint64_to_double(xoroshiro128plus_next(r->rng128_));
-#endif
+  const double res = ENGINE::nextDouble(r);
   return res;
 #else
   if (r->count_ == loopAvg) {
-#ifndef USE_XOSHIRO
-    const uint64_t localGen = tinymt64_generate_uint64(&(r->gen_));
-#else
-    const uint64_t localGen = xoshiro256plus_next(r->rng256_);
-#endif
+    const uint64_t localGen = ENGINE::next(r);
     const uint64_t local = localGen & maskAvg;
     const double res = local * maxAvgInv;
     r->count_ = 1;
@@ -149,45 +329,48 @@ template <> inline double vr_rand_ratio<double>(Vr_Rand *r) {
 #endif
 }
 
-template <> inline float vr_rand_ratio<float>(Vr_Rand *r) {
-#if VERROU_NUM_AVG == 1
-#ifndef USE_XOSHIRO
-  const double res = tinymt64_generate_double(&(r->gen_));
-#else
-  const float res = xoshiro_uint32_to_float(xoshiro128plus_next(r->rng128_));
-  //  const double
-  //  res=xoshiro_uint64_to_double(xoroshiro128plus_next(r->rng128_));
-#endif
-  return res;
-#else
-  if (r->count_ == loopAvg) {
-#ifndef USE_XOSHIRO
-    const uint64_t localGen = tinymt64_generate_uint64(&(r->gen_));
-#else
-    const uint64_t localGen = xoshiro256plus_next(r->rng256_);
-#endif
-    const uint32_t local = localGen & maskAvg;
-    const float res = local * maxAvgInv;
-    r->count_ = 1;
-    r->current_ = localGen;
-    return res;
-  }
-  const uint32_t local = (r->current_ >> (shiftAvgTab[r->count_])) & maskAvg;
-  const float res = local * maxAvgInv;
-  (r->count_)++;
-  return res;
-#endif
-}
-
-template <class OP> class vr_rand_prng {
+template <class OP, class ENGINE> class vr_rand_prngOf {
 public:
   static inline bool randBool(Vr_Rand *r, const typename OP::PackArgs &p) {
-    return vr_rand_bool(r);
+    return vr_rand_bool<ENGINE>(r);
   }
 
   static inline const typename OP::RealType
   randRatio(Vr_Rand *r, const typename OP::PackArgs &p) {
-    return vr_rand_ratio<typename OP::RealType>(r);
+    return vr_rand_ratio<typename OP::RealType, ENGINE>(r);
+  }
+};
+
+// engine selected at runtime (dynamic backend, exported kernels)
+template <class OP>
+using vr_rand_prng = vr_rand_prngOf<OP, vr_randEngineDynamic>;
+
+// engine fixed at compile time (static backends)
+template <class OP>
+using vr_rand_prngTinymt64 = vr_rand_prngOf<OP, vr_randEngineTinymt64>;
+template <class OP>
+using vr_rand_prngXoshiro256 = vr_rand_prngOf<OP, vr_randEngineXoshiro256>;
+template <class OP>
+using vr_rand_prngSfc64 = vr_rand_prngOf<OP, vr_randEngineSfc64>;
+template <class OP>
+using vr_rand_prngWyrand = vr_rand_prngOf<OP, vr_randEngineWyrand>;
+
+/*
+ * same draws as vr_rand_prng, taken from the block of r: only valid inside
+ * the reduction kernels, which refill the block
+ */
+template <class OP> class vr_rand_block {
+public:
+  static inline bool randBool(Vr_Rand *r,
+                              __attribute__((unused))
+                              const typename OP::PackArgs &p) {
+    return vr_rand_block_bool(&r->block_);
+  }
+
+  static inline const typename OP::RealType
+  randRatio(Vr_Rand *r,
+            __attribute__((unused)) const typename OP::PackArgs &p) {
+    return vr_rand_block_ratio<typename OP::RealType>(&r->block_);
   }
 };
 
@@ -0,0 +1,370 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Instrumented reduction kernels.                              ---*/
+/*---                                             vr_reduction.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+#include "vr_rand.h"
+#include "vr_roundingOp.hxx"
+
+// independent accumulation chains interleaved by the reduction kernels
+#define VR_REDUCTION_NB_CHAIN 4
+
+template <class OP> using vr_rand_p_block = vr_rand_p<OP, vr_rand_block>;
+template <class OP> using vr_rand_p_det = vr_rand_p<OP, vr_rand_det>;
+template <class OP> using vr_rand_p_comdet = vr_rand_p<OP, vr_rand_comdet>;
+
+/*
+ * One step of a reduction: rounded as OpWithSelectedRoundingMode<OP> does in
+ * the mode ROUND<OP, RAND<OP> >, with the same event recording and NaN/Inf
+ * check. DRAWS is the number of random draws available after refill() (0 for
+ * the modes which draw none); a step draws at most once.
+ */
+template <template <class, class> class ROUND, template <class> class RAND,
+          uint32_t DRAWS>
+class vr_reductionStep {
+public:
+  static const uint32_t nbDraw = DRAWS;
+
+  explicit vr_reductionStep(void *context)
+      : context_(context), rand_(vr_contextRand(context)) {}
+
+  inline void refill() {
+    if (DRAWS != 0) {
+      vr_rand_block_refill(&rand_->block_, rand_);
+    }
+  }
+
+  template <class OP>
+  inline typename OP::RealType apply(const typename OP::PackArgs &p) {
+    const typename OP::RealType res = ROUND<OP, RAND<OP> >::apply(p, rand_);
+    RECORD_EVENTS(OP, p, res);
+    vr_nanInfCheck<OP>(p, res, context_);
+    return res;
+  }
+
+private:
+  void *context_;
+  Vr_Rand *rand_;
+};
+
+/*
+ * Branchless steps for the prng stochastic modes: the direction of the
+ * rounding is random, so that any branch on it is mispredicted half of the
+ * time. The draws are taken from a block local to the kernel (kept in
+ * registers) and one draw is consumed at each step, exact or not. The results
+ * follow the same distribution as RoundingRandom and RoundingAverage.
+ */
+template <uint32_t DRAWS> class vr_reductionStepNoBranch {
+public:
+  static const uint32_t nbDraw = DRAWS;
+
+  explicit vr_reductionStepNoBranch(void *context)
+      : context_(context), pos_(0) {}
+
+  inline void refill() {
+    vr_rand_fill(vr_contextRand(context_), words_, VR_RAND_BLOCK_NB_WORDS);
+    pos_ = 0;
+  }
+
+protected:
+  template <class OP>
+  inline typename OP::RealType finish(const typename OP::PackArgs &p,
+                                      const typename OP::RealType &res) {
+    RECORD_EVENTS(OP, p, res);
+    if (__builtin_expect(isNanInf(res), 0)) {
+      vr_nanInfCheck<OP>(p, res, context_);
+    }
+    return res;
+  }
+
+  void *context_;
+  uint64_t words_[VR_RAND_BLOCK_NB_WORDS];
+  uint32_t pos_;
+};
+
+// RoundingRandom<OP, vr_rand_prng<OP> >
+class vr_reductionStepRandom
+    : public vr_reductionStepNoBranch<64 * VR_RAND_BLOCK_NB_WORDS> {
+public:
+  explicit vr_reductionStepRandom(void *context)
+      : vr_reductionStepNoBranch(context) {}
+
+  template <class OP>
+  inline typename OP::RealType apply(const typename OP::PackArgs &p) {
+    typedef typename OP::RealType RealType;
+    const RealType res = OP::nearestOp(p);
+    INC_OP;
+    const RealType signError = OP::sameSignOfError(p, res);
+#ifdef PROFILING_EXACT
+    if (signError == 0.) {
+      INC_EXACTOP;
+    }
+#endif
+    const bool doNoChange = (words_[pos_ / 64] >> (pos_ % 64)) & 1;
+    pos_++;
+    const bool change =
+        !doNoChange & (signError != 0.) & !isNanInf<RealType>(res);
+    const RealType moved = nextUlp<RealType>(res, signError > 0);
+    return finish<OP>(p, selectNoBranch<RealType>(change, moved, res));
+  }
+};
+
+// RoundingAverage<OP, vr_rand_prng<OP> >
+class vr_reductionStepAverage
+    : public vr_reductionStepNoBranch<VR_RAND_BLOCK_NB_WORDS> {
+public:
+  explicit vr_reductionStepAverage(void *context)
+      : vr_reductionStepNoBranch(context) {}
+
+  template <class OP>
+  inline typename OP::RealType apply(const typename OP::PackArgs &p) {
+    typedef typename OP::RealType RealType;
+    const RealType res = OP::nearestOp(p);
+    INC_OP;
+    const RealType error = OP::error(p, res);
+#ifdef PROFILING_EXACT
+    if (error == 0.) {
+      INC_EXACTOP;
+    }
+#endif
+    const RealType ratio = vr_rand_ratioOfWord<RealType>(words_[pos_++]);
+    const RealType moved = nextUlp<RealType>(res, error > 0);
+    const RealType u = __builtin_fabs(moved - res);
+    const bool change = !(ratio * u > __builtin_fabs(error)) &
+                        (error != 0.) & !isNanInf<RealType>(res);
+    return finish<OP>(p, selectNoBranch<RealType>(change, moved, res));
+  }
+};
+
+// refills the draws of step and returns the end of the block of steps
+// starting at begin, stride steps at a time
+template <class STEP>
+inline size_t vr_reduction_block(STEP &step, size_t begin, size_t end,
+                                 size_t stride) {
+  if (STEP::nbDraw == 0) {
+    return end;
+  }
+  step.refill();
+  return std::min(end, begin + (STEP::nbDraw / stride) * stride);
+}
+
+// pairwise combination of the chains, with at most VR_REDUCTION_NB_CHAIN-1
+// draws
+template <class OP, class STEP>
+inline typename OP::RealType vr_reduction_combine(STEP &step,
+                                                  typename OP::RealType *acc) {
+  for (size_t width = VR_REDUCTION_NB_CHAIN / 2; width > 0; width /= 2) {
+    for (size_t k = 0; k < width; k++) {
+      acc[k] = step.template apply<OP>(
+          typename OP::PackArgs(acc[k], acc[k + width]));
+    }
+  }
+  return acc[0];
+}
+
+// sum of x[i]: chain k accumulates the x[i] with i % VR_REDUCTION_NB_CHAIN == k
+template <class REAL> class vr_sumKernel {
+public:
+  typedef REAL ResultType;
+
+  vr_sumKernel(const REAL *x, size_t n, void *context)
+      : x_(x), n_(n), context_(context) {}
+
+  template <class STEP> inline REAL run() const {
+    typedef AddOp<REAL> Op;
+    STEP step(context_);
+    const REAL *x = x_;
+    const size_t n = n_;
+    const size_t nbChain = VR_REDUCTION_NB_CHAIN;
+    const size_t nMain = n - n % nbChain;
+    REAL acc[nbChain] = {};
+
+    size_t i = 0;
+    while (i < nMain) {
+      const size_t end = vr_reduction_block(step, i, nMain, nbChain);
+      for (; i < end; i += nbChain) {
+#pragma GCC unroll 4
+        for (size_t k = 0; k < nbChain; k++) {
+          // copy: the address of the accumulator must not escape
+          const REAL a = acc[k];
+          acc[k] = step.template apply<Op>(typename Op::PackArgs(a, x[i + k]));
+        }
+      }
+    }
+    step.refill();
+    for (; i < n; i++) {
+      acc[i - nMain] = step.template apply<Op>(
+          typename Op::PackArgs(acc[i - nMain], x[i]));
+    }
+    return vr_reduction_combine<Op>(step, acc);
+  }
+
+private:
+  const REAL *x_;
+  const size_t n_;
+  void *context_;
+};
+
+// sum of x[i]*y[i], each step being a fma on its chain accumulator
+template <class REAL> class vr_dotKernel {
+public:
+  typedef REAL ResultType;
+
+  vr_dotKernel(const REAL *x, const REAL *y, size_t n, void *context)
+      : x_(x), y_(y), n_(n), context_(context) {}
+
+  template <class STEP> inline REAL run() const {
+    typedef MAddOp<REAL> Op;
+    STEP step(context_);
+    const REAL *x = x_;
+    const REAL *y = y_;
+    const size_t n = n_;
+    const size_t nbChain = VR_REDUCTION_NB_CHAIN;
+    const size_t nMain = n - n % nbChain;
+    REAL acc[nbChain] = {};
+
+    size_t i = 0;
+    while (i < nMain) {
+      const size_t end = vr_reduction_block(step, i, nMain, nbChain);
+      for (; i < end; i += nbChain) {
+#pragma GCC unroll 4
+        for (size_t k = 0; k < nbChain; k++) {
+          const REAL a = acc[k];
+          acc[k] = step.template apply<Op>(
+              typename Op::PackArgs(x[i + k], y[i + k], a));
+        }
+      }
+    }
+    step.refill();
+    for (; i < n; i++) {
+      acc[i - nMain] = step.template apply<Op>(
+          typename Op::PackArgs(x[i], y[i], acc[i - nMain]));
+    }
+    return vr_reduction_combine<AddOp<REAL> >(step, acc);
+  }
+
+private:
+  const REAL *x_;
+  const REAL *y_;
+  const size_t n_;
+  void *context_;
+};
+
+// y[i] = a*x[i] + y[i], one fma per element: no chain, only the draws are
+// batched
+template <class REAL> class vr_axpyKernel {
+public:
+  typedef void ResultType;
+
+  vr_axpyKernel(REAL a, const REAL *x, REAL *y, size_t n, void *context)
+      : a_(a), x_(x), y_(y), n_(n), context_(context) {}
+
+  template <class STEP> inline void run() const {
+    typedef MAddOp<REAL> Op;
+    STEP step(context_);
+    const REAL a = a_;
+    const REAL *x = x_;
+    REAL *y = y_;
+
+    size_t i = 0;
+    while (i < n_) {
+      const size_t end = vr_reduction_block(step, i, n_, 1);
+      for (; i < end; i++) {
+        y[i] = step.template apply<Op>(typename Op::PackArgs(a, x[i], y[i]));
+      }
+    }
+  }
+
+private:
+  const REAL a_;
+  const REAL *x_;
+  REAL *y_;
+  const size_t n_;
+  void *context_;
+};
+
+/*
+ * Runs the kernel in the rounding mode of the context. The prng modes draw
+ * from the same generator as the element-wise ops, by blocks.
+ */
+template <class KERNEL>
+inline typename KERNEL::ResultType vr_reduction_dispatch(const KERNEL &k,
+                                                         void *context) {
+  const uint32_t nbRatio = VR_RAND_BLOCK_NB_WORDS;
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  switch (ctx->rounding_mode) {
+  case VR_NEAREST:
+    return k
+        .template run<vr_reductionStep<RoundingNearest, vr_rand_block, 0> >();
+  case VR_UPWARD:
+    return k
+        .template run<vr_reductionStep<RoundingUpward, vr_rand_block, 0> >();
+  case VR_DOWNWARD:
+    return k
+        .template run<vr_reductionStep<RoundingDownward, vr_rand_block, 0> >();
+  case VR_ZERO:
+    return k.template run<vr_reductionStep<RoundingZero, vr_rand_block, 0> >();
+  case VR_RANDOM:
+    return k.template run<vr_reductionStepRandom>();
+  case VR_RANDOM_DET:
+    return k.template run<vr_reductionStep<RoundingRandom, vr_rand_det, 0> >();
+  case VR_RANDOM_COMDET:
+    return k
+        .template run<vr_reductionStep<RoundingRandom, vr_rand_comdet, 0> >();
+  case VR_AVERAGE:
+    return k.template run<vr_reductionStepAverage>();
+  case VR_AVERAGE_DET:
+    return k.template run<vr_reductionStep<RoundingAverage, vr_rand_det, 0> >();
+  case VR_AVERAGE_COMDET:
+    return k
+        .template run<vr_reductionStep<RoundingAverage, vr_rand_comdet, 0> >();
+  case VR_PRANDOM:
+    return k.template run<
+        vr_reductionStep<RoundingPRandom, vr_rand_p_block, nbRatio> >();
+  case VR_PRANDOM_DET:
+    return k
+        .template run<vr_reductionStep<RoundingPRandom, vr_rand_p_det, 0> >();
+  case VR_PRANDOM_COMDET:
+    return k.template run<
+        vr_reductionStep<RoundingPRandom, vr_rand_p_comdet, 0> >();
+  case VR_FARTHEST:
+    return k
+        .template run<vr_reductionStep<RoundingFarthest, vr_rand_block, 0> >();
+  case VR_FLOAT:
+    return k.template run<vr_reductionStep<RoundingFloat, vr_rand_block, 0> >();
+  case VR_NATIVE:
+    return k
+        .template run<vr_reductionStep<RoundingNearest, vr_rand_block, 0> >();
+  case VR_FTZ:
+    interflop_panic("FTZ not implemented in backend_verrou");
+  }
+  return typename KERNEL::ResultType();
+}
@@ -39,6 +39,25 @@ extern vr_RoundingMode ROUNDINGMODE;
 // extern vr_RoundingMode ROUNDINGMODE;
 //#endif
 
+// context bound to the calling thread by verrou_bind_thread, NULL if none
+extern __thread verrou_context_t *vr_threadContext
+    __attribute__((tls_model("initial-exec")));
+
+// for the entry points which are not given a context
+static inline void *vr_boundContext(void *context) {
+  verrou_context_t *bound = vr_threadContext;
+  return bound != NULL ? bound : context;
+}
+
+static inline Vr_Rand *vr_boundRand(void) {
+  verrou_context_t *bound = vr_threadContext;
+  return bound != NULL ? bound->rand : &vr_rand;
+}
+
+static inline Vr_Rand *vr_contextRand(void *context) {
+  return ((verrou_context_t *)context)->rand;
+}
+
 #ifdef PROFILING_EXACT
 extern unsigned int vr_NumOp;
 extern unsigned int vr_NumExactOp;
@@ -55,14 +74,72 @@ extern unsigned int vr_NumExactOp;
 #include "vr_nextUlp.hxx"
 
 #include "interflop-stdlib/interflop_stdlib.h"
+#include "vr_control.hxx"
 #include "vr_op.hxx"
+#include "vr_sites.hxx"
+
+#ifdef PROFILING_EVENTS
+#ifndef VERROU_CANCELLATION_THRESHOLD
+#define VERROU_CANCELLATION_THRESHOLD 10
+#endif
+// histogram bins of lost bits, the last one also counts total cancellations
+#define VR_CANCELLATION_NB_BIN 64
+
+// counters of a thread, indexed by OP::getHash(), merged at finalize
+struct vr_eventTable_t {
+  uint64_t numOp[nbOpHash * nbTypeHash];
+  uint64_t cancellation[nbOpHash * nbTypeHash][VR_CANCELLATION_NB_BIN];
+  uint64_t absorption[nbOpHash * nbTypeHash];
+  uint64_t subnormalIn[nbOpHash * nbTypeHash];
+  uint64_t subnormalOut[nbOpHash * nbTypeHash];
+  vr_eventTable_t *next; // list of the tables of all threads
+};
+
+extern __thread vr_eventTable_t *vr_eventThreadTable
+    __attribute__((tls_model("initial-exec")));
+
+// table of the current thread, allocated on first use
+extern "C" vr_eventTable_t *vr_event_table_alloc(void) __attribute__((cold));
+
+template <class OP> class vr_events {
+public:
+  typedef typename OP::RealType RealType;
+  typedef typename OP::PackArgs PackArgs;
+
+  static inline void record(const PackArgs &p, const RealType &res) {
+    vr_eventTable_t *table = vr_eventThreadTable;
+    if (__builtin_expect(table == NULL, 0)) {
+      table = vr_event_table_alloc();
+    }
+    const uint64_t h = OP::getHash();
+    table->numOp[h]++;
+    const int lost = OP::cancellation(p, res);
+    if (lost > 0) {
+      table->cancellation[h][std::min(lost, VR_CANCELLATION_NB_BIN - 1)]++;
+    }
+    if (OP::isAbsorption(p, res)) {
+      table->absorption[h]++;
+    }
+    if (p.isOneArgSubnormal()) {
+      table->subnormalIn[h]++;
+    }
+    if (isSubnormal<RealType>(res)) {
+      table->subnormalOut[h]++;
+    }
+  }
+};
+#define RECORD_EVENTS(OP, p, res) vr_events<OP>::record(p, res)
+#else
+#define RECORD_EVENTS(OP, p, res)
+#endif
 
 template <class OP, class RAND = void> class RoundingNearest {
 public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     OP::check(p, res);
     return res;
@@ -74,7 +151,8 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     vr_roundFloat<typename PackArgs::RealType, PackArgs::nb> roundedArgs(p);
     const float res = (float)OP::nearestOp(roundedArgs.getPack());
     return RealType(res);
@@ -86,7 +164,7 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p, Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     INC_OP;
 #ifndef VERROU_IGNORE_NANINF_CHECK
@@ -101,7 +179,7 @@ public:
       INC_EXACTOP;
       return res;
     } else {
-      const bool doNoChange = RAND::randBool(&vr_rand, p);
+      const bool doNoChange = RAND::randBool(rand, p);
       if (doNoChange) {
         return res;
       } else {
@@ -120,7 +198,7 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p, Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     INC_OP;
 #ifndef VERROU_IGNORE_NANINF_CHECK
@@ -136,7 +214,7 @@ public:
       return res;
     } else {
       if (signError > 0) {
-        const bool doNoChange = RAND::randBool(&vr_rand, p);
+        const bool doNoChange = RAND::randBool(rand, p);
         if (doNoChange) {
           return res;
         } else {
@@ -147,7 +225,7 @@ public:
           }
         }
       }
-      const bool doChange = !RAND::randBool(&vr_rand, p);
+      const bool doChange = !RAND::randBool(rand, p);
       if (doChange) {
         return res;
       } else {
@@ -166,7 +244,7 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p, Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
 
     INC_OP;
@@ -187,7 +265,7 @@ public:
       const RealType u(nextRes - res);
       const int s(1);
       const bool doNotChange =
-          ((RAND::randRatio(&vr_rand, p) * u) > (s * error));
+          ((RAND::randRatio(rand, p) * u) > (s * error));
       if (doNotChange) {
         return res;
       } else {
@@ -199,7 +277,7 @@ public:
       const RealType u(res - prevRes);
       const int s(-1);
       const bool doNotChange =
-          ((RAND::randRatio(&vr_rand, p) * u) > (s * error));
+          ((RAND::randRatio(rand, p) * u) > (s * error));
       if (doNotChange) {
         return res;
       } else {
@@ -215,7 +293,8 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     INC_OP;
     OP::check(p, res);
@@ -256,7 +335,8 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     OP::check(p, res);
     INC_OP;
@@ -298,7 +378,8 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     OP::check(p, res);
     INC_OP;
@@ -335,12 +416,159 @@ public:
   };
 };
 
+#if defined(__x86_64__)
+#define VR_HARDWARE_ROUNDING
+
+// rounding control field of MXCSR, also selecting the embedded rounding
+#define VR_MXCSR_RC_DOWNWARD 0x2000
+#define VR_MXCSR_RC_UPWARD 0x4000
+#define VR_MXCSR_RC_ZERO 0x6000
+
+/*
+ * With AVX-512 the rounding mode is encoded in the instruction itself
+ * (embedded rounding), so MXCSR is not touched at all. The EVEX encoded
+ * instructions are emitted through inline asm and only executed when CPUID
+ * reported AVX-512F (vr_hardwareEmbeddedRounding).
+ */
+extern bool vr_hardwareEmbeddedRounding;
+
+#define VR_EMBEDDED_ROUNDING(RC, INSN, OPERANDS, OUTPUT, ...)                  \
+  switch (RC) {                                                                \
+  case VR_MXCSR_RC_DOWNWARD:                                                   \
+    __asm__(INSN " %{rd-sae%}, " OPERANDS : OUTPUT : __VA_ARGS__);             \
+    break;                                                                     \
+  case VR_MXCSR_RC_UPWARD:                                                     \
+    __asm__(INSN " %{ru-sae%}, " OPERANDS : OUTPUT : __VA_ARGS__);             \
+    break;                                                                     \
+  default:                                                                     \
+    __asm__(INSN " %{rz-sae%}, " OPERANDS : OUTPUT : __VA_ARGS__);             \
+  }
+
+template <class OP> struct vr_embeddedRoundingOp;
+
+#define VR_EMBEDDED_ROUNDING_OP2(OPTYPE, INSN)                                 \
+  template <> struct vr_embeddedRoundingOp<OPTYPE> {                           \
+    template <unsigned int RC>                                                 \
+    static inline OPTYPE::RealType apply(const OPTYPE::PackArgs &p) {          \
+      OPTYPE::RealType res;                                                    \
+      VR_EMBEDDED_ROUNDING(RC, INSN, "%2, %1, %0", "=v"(res), "v"(p.arg1),     \
+                           "v"(p.arg2));                                       \
+      return res;                                                              \
+    }                                                                          \
+  };
+
+#define VR_EMBEDDED_ROUNDING_FMA(OPTYPE, INSN)                                 \
+  template <> struct vr_embeddedRoundingOp<OPTYPE> {                           \
+    template <unsigned int RC>                                                 \
+    static inline OPTYPE::RealType apply(const OPTYPE::PackArgs &p) {          \
+      OPTYPE::RealType res = p.arg3;                                           \
+      VR_EMBEDDED_ROUNDING(RC, INSN, "%2, %1, %0", "+v"(res), "v"(p.arg1),     \
+                           "v"(p.arg2));                                       \
+      return res;                                                              \
+    }                                                                          \
+  };
+
+VR_EMBEDDED_ROUNDING_OP2(AddOp<double>, "vaddsd")
+VR_EMBEDDED_ROUNDING_OP2(AddOp<float>, "vaddss")
+VR_EMBEDDED_ROUNDING_OP2(SubOp<double>, "vsubsd")
+VR_EMBEDDED_ROUNDING_OP2(SubOp<float>, "vsubss")
+VR_EMBEDDED_ROUNDING_OP2(MulOp<double>, "vmulsd")
+VR_EMBEDDED_ROUNDING_OP2(MulOp<float>, "vmulss")
+VR_EMBEDDED_ROUNDING_OP2(DivOp<double>, "vdivsd")
+VR_EMBEDDED_ROUNDING_OP2(DivOp<float>, "vdivss")
+VR_EMBEDDED_ROUNDING_FMA(MAddOp<double>, "vfmadd231sd")
+VR_EMBEDDED_ROUNDING_FMA(MAddOp<float>, "vfmadd231ss")
+
+template <> struct vr_embeddedRoundingOp<CastOp<double, float>> {
+  template <unsigned int RC>
+  static inline float apply(const vr_packArg<double, 1> &p) {
+    float res;
+    VR_EMBEDDED_ROUNDING(RC, "vcvtsd2ss", "%1, %1, %0", "=v"(res),
+                         "v"(p.arg1));
+    return res;
+  }
+};
+
+/*
+ * Directed rounding done by the hardware instead of being emulated from the
+ * sign of the error (--hardware-rounding). The rounding mode is embedded in
+ * the instruction, so MXCSR, and the rounding of libm and of the rest of the
+ * code that is not instrumented, are never changed.
+ * SOFT is the software emulation, used without AVX-512 (setting MXCSR around
+ * each op instead costs about twice the emulation) and, with
+ * VERROU_CHECK_HARDWARE_ROUNDING, to check every result.
+ */
+template <class OP, class RAND, unsigned int RC,
+          template <class O, class R> class SOFT>
+class RoundingHardware {
+public:
+  typedef typename OP::RealType RealType;
+  typedef typename OP::PackArgs PackArgs;
+
+  // always_inline: the SOFT fallback must be expanded in each multiarch
+  // clone too, which flatten alone does not guarantee
+  __attribute__((always_inline)) static inline RealType
+  apply(const PackArgs &p, Vr_Rand *rand) {
+    if (!vr_hardwareEmbeddedRounding) {
+      return SOFT<OP, RAND>::apply(p, rand);
+    }
+    const RealType res = vr_embeddedRoundingOp<OP>::template apply<RC>(p);
+    OP::check(p, res);
+    INC_OP;
+#ifdef VERROU_CHECK_HARDWARE_ROUNDING
+    const RealType soft = SOFT<OP, RAND>::apply(p, rand);
+    double args[3] = {0., 0., 0.};
+    p.serialyzeDouble(args);
+    // the emulation does not follow the hardware on signed zeros and when
+    // the error terms underflow or overflow
+    bool extreme = soft == 0 || res == 0 || outOfRange<RealType>(soft) ||
+                   outOfRange<RealType>(res);
+    for (int i = 0; i < PackArgs::nb; i++) {
+      extreme |= outOfRange<typename PackArgs::RealType>(
+          (typename PackArgs::RealType)args[i]);
+    }
+    if (soft != res && !(soft != soft && res != res) && !extreme) {
+      char msg[256];
+      interflop_sprintf(msg,
+                        "hardware rounding differs from the software "
+                        "emulation: %a %a %a -> %a instead of %a\n",
+                        args[0], args[1], args[2], (double)res, (double)soft);
+      interflop_panic(msg);
+    }
+#endif
+    return res;
+  }
+
+#ifdef VERROU_CHECK_HARDWARE_ROUNDING
+private:
+  // the error of an op on x may not be representable
+  template <class REAL> static inline bool outOfRange(const REAL &x) {
+    const REAL scale = (REAL)(1ULL << std::numeric_limits<REAL>::digits);
+    const REAL a = __builtin_fabs(x);
+    return x != 0 && (a < std::numeric_limits<REAL>::min() * scale ||
+                      a > std::numeric_limits<REAL>::max() / scale);
+  }
+#endif
+};
+
+template <class OP, class RAND = void>
+using RoundingUpwardHardware =
+    RoundingHardware<OP, RAND, VR_MXCSR_RC_UPWARD, RoundingUpward>;
+template <class OP, class RAND = void>
+using RoundingDownwardHardware =
+    RoundingHardware<OP, RAND, VR_MXCSR_RC_DOWNWARD, RoundingDownward>;
+template <class OP, class RAND = void>
+using RoundingZeroHardware =
+    RoundingHardware<OP, RAND, VR_MXCSR_RC_ZERO, RoundingZero>;
+#endif
+
 template <class OP, class RAND = void> class RoundingFarthest {
 public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs &p) {
+  static inline RealType apply(const PackArgs &p,
+                               __attribute__((unused)) Vr_Rand *rand) {
     const RealType res = OP::nearestOp(p);
     INC_OP;
 #ifndef VERROU_IGNORE_NANINF_CHECK
@@ -376,26 +604,85 @@ public:
 
 #include "vr_op.hxx"
 
+/*
+ * NaN/Inf reporting policies, applied on the result of each op. The static
+ * backends are instantiated once per policy, so that VR_NANINF_IGNORE
+ * costs nothing.
+ */
+extern "C" void vr_nanInfRecord(uint32_t opHash, int nbArgs,
+                                const double *args, double res);
+
+class vr_nanInfIgnore {
+public:
+  template <class OP>
+  static inline void
+  check(__attribute__((unused)) const typename OP::PackArgs &p,
+        __attribute__((unused)) const typename OP::RealType &res) {}
+};
+
+class vr_nanInfHandler {
+public:
+  template <class OP>
+  static inline void
+  check(__attribute__((unused)) const typename OP::PackArgs &p,
+        const typename OP::RealType &res) {
+    if (isNanInf(res)) {
+      if (isNan(res)) {
+        interflop_nanHandler();
+      }
+      if (isinf(res)) {
+        interflop_infHandler();
+      }
+    }
+  }
+};
+
+class vr_nanInfCount {
+public:
+  template <class OP>
+  static inline void check(const typename OP::PackArgs &p,
+                           const typename OP::RealType &res) {
+    if (__builtin_expect(isNanInf(res), 0)) {
+      double args[OP::PackArgs::nb];
+      p.serialyzeDouble(args);
+      vr_nanInfRecord(OP::getHash(), OP::PackArgs::nb, args, res);
+    }
+  }
+};
+
+// NaN/Inf check of the dynamic paths, selected by ctx->naninf_mode
+template <class OP>
+static inline void vr_nanInfCheck(const typename OP::PackArgs &p,
+                                  const typename OP::RealType &res,
+                                  void *context) {
+#ifndef VERROU_IGNORE_NANINF_CHECK
+  verrou_context_t *ctx = (verrou_context_t *)context;
+  if (ctx->naninf_mode == VR_NANINF_HANDLER) {
+    vr_nanInfHandler::check<OP>(p, res);
+  } else if (ctx->naninf_mode == VR_NANINF_COUNT) {
+    vr_nanInfCount::check<OP>(p, res);
+  }
+#endif
+}
+
 template <class OP> class OpWithSelectedRoundingMode {
 public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline void apply(const PackArgs &p, RealType *res, void *context) {
+  // inlined in the entry points, for RECORD_SITE
+  __attribute__((always_inline)) static inline void
+  apply(const PackArgs &p, RealType *res, void *context) {
+    if (vr_control != NULL) {
+      vr_control_tick(OP::getHash(), context);
+    }
     *res = applySeq(p, context);
+    RECORD_EVENTS(OP, p, *res);
+    RECORD_SITE(OP, p, *res);
 #ifdef DEBUG_PRINT_OP
     print_debug(p, res);
 #endif
-#ifndef VERROU_IGNORE_NANINF_CHECK
-    if (isNanInf(*res)) {
-      if (isNan(*res)) {
-        interflop_nanHandler();
-      }
-      if (isinf(*res)) {
-        interflop_infHandler();
-      }
-    }
-#endif
+    vr_nanInfCheck<OP>(p, *res, context);
   }
 
 #ifdef DEBUG_PRINT_OP
@@ -413,39 +700,40 @@ public:
 
   static inline RealType applySeq(const PackArgs &p, void *context) {
     verrou_context_t *ctx = (verrou_context_t *)context;
+    Vr_Rand *rand = ctx->rand;
     switch (ctx->rounding_mode) {
     case VR_NEAREST:
-      return RoundingNearest<OP>::apply(p);
+      return RoundingNearest<OP>::apply(p, rand);
     case VR_UPWARD:
-      return RoundingUpward<OP>::apply(p);
+      return RoundingUpward<OP>::apply(p, rand);
     case VR_DOWNWARD:
-      return RoundingDownward<OP>::apply(p);
+      return RoundingDownward<OP>::apply(p, rand);
     case VR_ZERO:
-      return RoundingZero<OP>::apply(p);
+      return RoundingZero<OP>::apply(p, rand);
     case VR_RANDOM:
-      return RoundingRandom<OP, vr_rand_prng<OP>>::apply(p);
+      return RoundingRandom<OP, vr_rand_prng<OP>>::apply(p, rand);
     case VR_RANDOM_DET:
-      return RoundingRandom<OP, vr_rand_det<OP>>::apply(p);
+      return RoundingRandom<OP, vr_rand_det<OP>>::apply(p, rand);
     case VR_RANDOM_COMDET:
-      return RoundingRandom<OP, vr_rand_comdet<OP>>::apply(p);
+      return RoundingRandom<OP, vr_rand_comdet<OP>>::apply(p, rand);
     case VR_AVERAGE:
-      return RoundingAverage<OP, vr_rand_prng<OP>>::apply(p);
+      return RoundingAverage<OP, vr_rand_prng<OP>>::apply(p, rand);
     case VR_AVERAGE_DET:
-      return RoundingAverage<OP, vr_rand_det<OP>>::apply(p);
+      return RoundingAverage<OP, vr_rand_det<OP>>::apply(p, rand);
     case VR_AVERAGE_COMDET:
-      return RoundingAverage<OP, vr_rand_comdet<OP>>::apply(p);
+      return RoundingAverage<OP, vr_rand_comdet<OP>>::apply(p, rand);
     case VR_PRANDOM:
-      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_prng>>::apply(p);
+      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_prng>>::apply(p, rand);
     case VR_PRANDOM_DET:
-      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_det>>::apply(p);
+      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_det>>::apply(p, rand);
     case VR_PRANDOM_COMDET:
-      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_comdet>>::apply(p);
+      return RoundingPRandom<OP, vr_rand_p<OP, vr_rand_comdet>>::apply(p, rand);
     case VR_FARTHEST:
-      return RoundingFarthest<OP>::apply(p);
+      return RoundingFarthest<OP>::apply(p, rand);
     case VR_FLOAT:
-      return RoundingFloat<OP>::apply(p);
+      return RoundingFloat<OP>::apply(p, rand);
     case VR_NATIVE:
-      return RoundingNearest<OP>::apply(p);
+      return RoundingNearest<OP>::apply(p, rand);
     case VR_FTZ:
       interflop_panic("FTZ not implemented in backend_verrou");
     }
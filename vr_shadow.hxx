@@ -0,0 +1,105 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Double-double shadow values.                                 ---*/
+/*---                                               vr_shadow.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+#include "vr_op.hxx"
+
+/*
+ * Double-double arithmetic of the shadow values (verrou_shadow_t): hi + lo
+ * with |lo| <= ulp(hi) / 2, built on the error-free transformations
+ * AddOp::twoSum and MulOp::twoProd. The ops are the usual "sloppy" ones,
+ * accurate to about 2^-104 relative except for the sums with cancellation,
+ * which is more than enough to measure the error of a double result.
+ */
+class vr_doubleDouble {
+public:
+  double hi;
+  double lo;
+
+  inline vr_doubleDouble() : hi(0.), lo(0.) {}
+  inline vr_doubleDouble(double h, double l = 0.) : hi(h), lo(l) {}
+
+  static inline vr_doubleDouble add(const vr_doubleDouble &a,
+                                    const vr_doubleDouble &b) {
+    double s, e;
+    AddOp<double>::twoSum(a.hi, b.hi, s, e);
+    return renormalize(s, e + (a.lo + b.lo));
+  }
+
+  static inline vr_doubleDouble neg(const vr_doubleDouble &a) {
+    return vr_doubleDouble(-a.hi, -a.lo);
+  }
+
+  static inline vr_doubleDouble mul(const vr_doubleDouble &a,
+                                    const vr_doubleDouble &b) {
+    double p, e;
+    MulOp<double>::twoProd(a.hi, b.hi, p, e);
+    return renormalize(p, e + (a.hi * b.lo + a.lo * b.hi));
+  }
+
+  // one correction step of the quotient q = a.hi / b.hi
+  static inline vr_doubleDouble div(const vr_doubleDouble &a,
+                                    const vr_doubleDouble &b) {
+    const double q = a.hi / b.hi;
+    double p, e;
+    MulOp<double>::twoProd(q, b.hi, p, e);
+    const double r = (((a.hi - p) - e) + a.lo) - q * b.lo;
+    return renormalize(q, r / b.hi);
+  }
+
+  // one Newton step from the double square root of hi
+  static inline vr_doubleDouble sqrt(const vr_doubleDouble &a) {
+    if (!(a.hi > 0.)) {
+      return vr_doubleDouble(__builtin_sqrt(a.hi));
+    }
+    const double s = __builtin_sqrt(a.hi);
+    double p, e;
+    MulOp<double>::twoProd(s, s, p, e);
+    return renormalize(s, (((a.hi - p) - e) + a.lo) / (2. * s));
+  }
+
+  // relative error of x with respect to hi + lo
+  inline double relativeError(double x) const {
+    if (x == hi && lo == 0.) {
+      return 0.; // also the infinities
+    }
+    const double diff = (x - hi) - lo; // x - hi exact when close
+    return __builtin_fabs(diff) / __builtin_fabs(hi);
+  }
+
+private:
+  static inline vr_doubleDouble renormalize(double h, double l) {
+    double s, e;
+    AddOp<double>::twoSum(h, l, s, e);
+    return vr_doubleDouble(s, e);
+  }
+};
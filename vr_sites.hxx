@@ -0,0 +1,194 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Profiling of the instrumented ops by call site.              ---*/
+/*---                                                vr_sites.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+// the mixed precision advice is given per call site
+#if defined(PROFILING_PRECISION) && !defined(PROFILING_SITES)
+#define PROFILING_SITES
+#endif
+
+#ifdef PROFILING_SITES
+#include "vr_isNan.hxx"
+#include <type_traits>
+
+#ifdef PROFILING_PRECISION
+// relative difference of the float result beyond which a double op is
+// reported as not demotable (about 8 ulps of float)
+#ifndef VERROU_PRECISION_TOLERANCE
+#define VERROU_PRECISION_TOLERANCE 1e-6
+#endif
+#endif
+
+/*
+ * With PROFILING_SITES, each op is attributed to its call site: the return
+ * address of the backend entry point called by the application. Every thread
+ * counts into its own open addressing hash table, keyed by the call site, so
+ * that recording needs neither atomics nor locks. The tables are merged and
+ * printed at finalize (verrou_print_profiling_sites), with the addresses
+ * resolved against /proc/self/maps into object file and offset, to be given
+ * to addr2line.
+ */
+struct vr_siteEntry_t {
+  uintptr_t site; // 0 for an empty slot
+  uint32_t op;    // OP::getHash() of the first op seen at the site
+  uint64_t nbOp;
+  uint64_t nbInexact; // the exact result is not a floating point number
+  uint64_t nbMoved;   // the result is not the one rounded to nearest
+#ifdef PROFILING_PRECISION
+  // double ops only: binary exponents of the nonzero operands and results,
+  // and number of float results beyond VERROU_PRECISION_TOLERANCE
+  int32_t minExp;
+  int32_t maxExp;
+  uint64_t nbDouble;
+  uint64_t nbFloatDiff;
+#endif
+};
+
+struct vr_siteTable_t {
+  vr_siteEntry_t *entries;
+  uint64_t capacity; // power of 2
+  uint64_t size;
+  vr_siteTable_t *next; // list of the tables of all threads
+};
+
+extern __thread vr_siteTable_t *vr_siteThreadTable
+    __attribute__((tls_model("initial-exec")));
+
+// slot of site in the table of the current thread, inserted if needed
+extern "C" vr_siteEntry_t *vr_site_insert(uintptr_t site, uint32_t op)
+    __attribute__((cold));
+
+__attribute__((always_inline)) inline vr_siteEntry_t *
+vr_site_lookup(uintptr_t site, uint32_t op) {
+  vr_siteTable_t *table = vr_siteThreadTable;
+  if (__builtin_expect(table != NULL, 1)) {
+    const uint64_t mask = table->capacity - 1;
+    uint64_t i = (site * 0x9E3779B97F4A7C15ULL) >> 32;
+    for (;; i++) {
+      vr_siteEntry_t *entry = &table->entries[i & mask];
+      if (entry->site == site) {
+        return entry;
+      }
+      if (entry->site == 0) {
+        break;
+      }
+    }
+  }
+  return vr_site_insert(site, op);
+}
+
+#ifdef PROFILING_PRECISION
+/*
+ * With PROFILING_PRECISION, the double ops of each site are also evaluated as
+ * RoundingFloat does (operands and result rounded to float), to tell whether
+ * the site could be demoted to float: see verrou_print_precision_advice.
+ */
+template <class OP,
+          bool DOUBLE = std::is_same<typename OP::RealType, double>::value>
+class vr_sitePrecision {
+public:
+  static inline void record(vr_siteEntry_t *entry,
+                            const typename OP::PackArgs &p,
+                            const typename OP::RealType &nearest) {}
+};
+
+template <class OP> class vr_sitePrecision<OP, true> {
+public:
+  typedef typename OP::PackArgs PackArgs;
+
+  static inline void record(vr_siteEntry_t *entry, const PackArgs &p,
+                            const double &nearest) {
+    double args[PackArgs::nb];
+    p.serialyzeDouble(args);
+    for (int i = 0; i < PackArgs::nb; i++) {
+      exponent(entry, args[i]);
+    }
+    exponent(entry, nearest);
+    entry->nbDouble++;
+
+    vr_roundFloat<typename PackArgs::RealType, PackArgs::nb> roundedArgs(p);
+    const double res = (float)OP::nearestOp(roundedArgs.getPack());
+    const double diff = __builtin_fabs(res - nearest);
+    if (!(diff <= VERROU_PRECISION_TOLERANCE * __builtin_fabs(nearest))) {
+      entry->nbFloatDiff++;
+    }
+  }
+
+private:
+  // unbiased exponent, -1023 for the subnormals
+  static inline void exponent(vr_siteEntry_t *entry, double x) {
+    uint64_t u;
+    __builtin_memcpy(&u, &x, sizeof(u));
+    if ((u << 1) == 0) {
+      return;
+    }
+    const int32_t e = (int32_t)((u >> 52) & 0x7ff) - 1023;
+    entry->minExp = e < entry->minExp ? e : entry->minExp;
+    entry->maxExp = e > entry->maxExp ? e : entry->maxExp;
+  }
+};
+#define RECORD_PRECISION(OP, entry, p, nearest)                                \
+  vr_sitePrecision<OP>::record(entry, p, nearest)
+#else
+#define RECORD_PRECISION(OP, entry, p, nearest)
+#endif
+
+template <class OP> class vr_sites {
+public:
+  typedef typename OP::RealType RealType;
+  typedef typename OP::PackArgs PackArgs;
+
+  static inline void record(void *site, const PackArgs &p,
+                            const RealType &res) {
+    vr_siteEntry_t *entry = vr_site_lookup((uintptr_t)site, OP::getHash());
+    entry->nbOp++;
+    const RealType nearest = OP::nearestOp(p);
+    if (isNanInf<RealType>(nearest)) {
+      return;
+    }
+    RECORD_PRECISION(OP, entry, p, nearest);
+    if (OP::sameSignOfError(p, nearest) != 0) {
+      entry->nbInexact++;
+    }
+    if (res != nearest) {
+      entry->nbMoved++;
+    }
+  }
+};
+
+// to be expanded in the function called by the application (always_inline)
+#define RECORD_SITE(OP, p, res)                                                \
+  vr_sites<OP>::record(                                                        \
+      __builtin_extract_return_addr(__builtin_return_address(0)), p, res)
+#else
+#define RECORD_SITE(OP, p, res)
+#endif
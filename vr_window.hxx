@@ -0,0 +1,313 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Instrumentation windows by op index.                         ---*/
+/*---                                               vr_window.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2021 EDF
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU Lesser General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+
+#include "vr_multiarch.hxx"
+#include "vr_op.hxx"
+
+// maximal number of ranges in --instr-windows
+#define VR_WINDOW_NB_RANGE 32
+
+/*
+ * Op indices are counted per thread. The ops of a thread are split into
+ * segments which are either inside or outside the windows: an op only
+ * decrements the countdown to the end of its segment, and the next segment
+ * is looked up when it reaches 0.
+ */
+struct vr_windowThread_t {
+  uint64_t countdown; // ops left in the current segment
+  uint64_t end;       // index of the first op after the current segment
+  bool inside;
+};
+
+extern __thread vr_windowThread_t vr_windowThread
+    __attribute__((tls_model("initial-exec")));
+
+extern "C" void vr_window_advance(void) __attribute__((cold));
+
+// forced inline: this check is all an op outside the windows pays
+__attribute__((always_inline)) inline bool vr_window_inside(void) {
+  if (__builtin_expect(vr_windowThread.countdown == 0, 0)) {
+    vr_window_advance();
+  }
+  vr_windowThread.countdown--;
+  return vr_windowThread.inside;
+}
+
+// BACKEND kernels inside the windows, native ops outside. BACKEND::apply is
+// inlined in the wrappers, which are thus cloned as the kernels themselves.
+template <class BACKEND> class vr_windowBackend {
+  using AD = AddOp<double>;
+  using AF = AddOp<float>;
+  using SD = SubOp<double>;
+  using SF = SubOp<float>;
+  using MD = MulOp<double>;
+  using MF = MulOp<float>;
+  using DD = DivOp<double>;
+  using DF = DivOp<float>;
+  using CDF = CastOp<double, float>;
+  using FD = MAddOp<double>;
+  using FF = MAddOp<float>;
+
+public:
+  VR_MULTIARCH_KERNEL static void add_double(double a, double b, double *res,
+                                             void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<AD>(typename AD::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = AD::nearestOp(typename AD::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void add_float(float a, float b, float *res,
+                                            void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<AF>(typename AF::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = AF::nearestOp(typename AF::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void sub_double(double a, double b, double *res,
+                                             void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<SD>(typename SD::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = SD::nearestOp(typename SD::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void sub_float(float a, float b, float *res,
+                                            void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<SF>(typename SF::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = SF::nearestOp(typename SF::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void mul_double(double a, double b, double *res,
+                                             void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<MD>(typename MD::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = MD::nearestOp(typename MD::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void mul_float(float a, float b, float *res,
+                                            void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<MF>(typename MF::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = MF::nearestOp(typename MF::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void div_double(double a, double b, double *res,
+                                             void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<DD>(typename DD::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = DD::nearestOp(typename DD::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void div_float(float a, float b, float *res,
+                                            void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<DF>(typename DF::PackArgs(a, b),
+                                         vr_contextRand(context));
+    } else {
+      *res = DF::nearestOp(typename DF::PackArgs(a, b));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void cast_double_to_float(double a, float *res,
+                                                       void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<CDF>(typename CDF::PackArgs(a),
+                                          vr_contextRand(context));
+    } else {
+      *res = CDF::nearestOp(typename CDF::PackArgs(a));
+    }
+  }
+
+  // the native fma is an instruction in the x86-64-v3 and v4 clones
+  VR_MULTIARCH_KERNEL static void fma_double(double a, double b, double c,
+                                             double *res, void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<FD>(typename FD::PackArgs(a, b, c),
+                                         vr_contextRand(context));
+    } else {
+      *res = FD::nearestOp(typename FD::PackArgs(a, b, c));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static void fma_float(float a, float b, float c,
+                                            float *res, void *context) {
+    if (vr_window_inside()) {
+      *res = BACKEND::template apply<FF>(typename FF::PackArgs(a, b, c),
+                                         vr_contextRand(context));
+    } else {
+      *res = FF::nearestOp(typename FF::PackArgs(a, b, c));
+    }
+  }
+
+  VR_MULTIARCH_KERNEL static double add_double_value(double a, double b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<AD>(typename AD::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return AD::nearestOp(typename AD::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static float add_float_value(float a, float b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<AF>(typename AF::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return AF::nearestOp(typename AF::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static double sub_double_value(double a, double b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<SD>(typename SD::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return SD::nearestOp(typename SD::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static float sub_float_value(float a, float b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<SF>(typename SF::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return SF::nearestOp(typename SF::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static double mul_double_value(double a, double b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<MD>(typename MD::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return MD::nearestOp(typename MD::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static float mul_float_value(float a, float b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<MF>(typename MF::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return MF::nearestOp(typename MF::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static double div_double_value(double a, double b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<DD>(typename DD::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return DD::nearestOp(typename DD::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static float div_float_value(float a, float b) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<DF>(typename DF::PackArgs(a, b),
+                                         vr_boundRand());
+    }
+    return DF::nearestOp(typename DF::PackArgs(a, b));
+  }
+
+  VR_MULTIARCH_KERNEL static float cast_double_to_float_value(double a) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<CDF>(typename CDF::PackArgs(a),
+                                          vr_boundRand());
+    }
+    return CDF::nearestOp(typename CDF::PackArgs(a));
+  }
+
+  VR_MULTIARCH_KERNEL static double fma_double_value(double a, double b,
+                                                     double c) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<FD>(typename FD::PackArgs(a, b, c),
+                                         vr_boundRand());
+    }
+    return FD::nearestOp(typename FD::PackArgs(a, b, c));
+  }
+
+  VR_MULTIARCH_KERNEL static float fma_float_value(float a, float b, float c) {
+    if (vr_window_inside()) {
+      return BACKEND::template apply<FF>(typename FF::PackArgs(a, b, c),
+                                         vr_boundRand());
+    }
+    return FF::nearestOp(typename FF::PackArgs(a, b, c));
+  }
+
+  static struct interflop_backend_interface_t get_backend(void) {
+    struct interflop_backend_interface_t backend = BACKEND::get_backend();
+    backend.interflop_add_float = add_float;
+    backend.interflop_sub_float = sub_float;
+    backend.interflop_mul_float = mul_float;
+    backend.interflop_div_float = div_float;
+    backend.interflop_add_double = add_double;
+    backend.interflop_sub_double = sub_double;
+    backend.interflop_mul_double = mul_double;
+    backend.interflop_div_double = div_double;
+    backend.interflop_cast_double_to_float = cast_double_to_float;
+    backend.interflop_fma_float = fma_float;
+    backend.interflop_fma_double = fma_double;
+    return backend;
+  }
+
+  static verrou_value_backend_t get_value_backend(void) {
+    return {
+      add_float : add_float_value,
+      sub_float : sub_float_value,
+      mul_float : mul_float_value,
+      div_float : div_float_value,
+      add_double : add_double_value,
+      sub_double : sub_double_value,
+      mul_double : mul_double_value,
+      div_double : div_double_value,
+      cast_double_to_float : cast_double_to_float_value,
+      fma_float : fma_float_value,
+      fma_double : fma_double_value
+    };
+  }
+};